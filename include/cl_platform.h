@@ -0,0 +1,14 @@
+#ifndef CL_PLATFORM_H
+#define CL_PLATFORM_H
+
+#define CL_TARGET_OPENCL_VERSION 120
+#ifdef __APPLE__
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wnullability-completeness-on-arrays"
+#include <OpenCL/opencl.h>
+#pragma clang diagnostic pop
+#else
+#include <CL/cl.h>
+#endif
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "oneapi/tbb/task_scheduler_observer.h"
+
+// Bytes each last level cache miss brings in
+const int CACHE_LINE_BYTES = 64;
+
+enum class Phase { Init, Step, Vertices, Readback, Count };
+
+enum Counter { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, COUNTER_COUNT };
+
+/* Totals of one phase, counters a machine lacks stay at -1 */
+typedef struct {
+    int64_t counts[COUNTER_COUNT]; // summed over every thread
+    int64_t owner[COUNTER_COUNT];  // the thread running the phases alone
+    uint64_t cells;  // cells the phase went over, board cells or drawn points
+    uint64_t frames;
+} PhaseCounts;
+
+/* Hardware counters from perf_event_open around each CPU side phase of a
+ * frame. Every thread that joins the TBB arena gets its own group of
+ * counters as it enters, read together so their ratios hold. Groups are
+ * only enabled between begin() and end(), so workers idling between phases
+ * aren't counted, though a worker spinning for work inside a phase still
+ * is. That's why the thread running the phases is also reported alone.
+ * Only Linux has perf events, elsewhere ok() is false. */
+class PerfCounters : public oneapi::tbb::task_scheduler_observer {
+public:
+    PerfCounters();
+    ~PerfCounters();
+    // False when the kernel won't count, see /proc/sys/kernel/perf_event_paranoid
+    bool ok() const;
+    void begin(Phase phase);
+    void end(Phase phase, uint64_t cells);
+    const PhaseCounts& counts(Phase phase) const;
+    /* Prints IPC, cache and branch misses per cell and bytes per cell of
+     * every phase per frame since the last reset */
+    void report() const;
+    void reset();
+
+    void on_scheduler_entry(bool worker) override;
+private:
+    struct Thread {
+        int fds[COUNTER_COUNT]; // -1 where the event isn't available, CYCLES leads the group
+        int64_t started[COUNTER_COUNT]; // scaled counts when the phase began
+    };
+    void open();
+    // Scaled counts of a thread, -1 for events it doesn't have
+    void read(const Thread& thread, int64_t* counts);
+    static void report_line(const char* name, const int64_t* values, const PhaseCounts& counts);
+
+    bool m_ok;
+    std::thread::id m_owner; // the thread phases begin and end on
+    std::mutex m_mutex;
+    std::map<std::thread::id, std::unique_ptr<Thread>> m_threads;
+    bool m_counting; // inside a phase, threads joining now start enabled
+    PhaseCounts m_phases[int(Phase::Count)];
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef CYCLE_H
+#define CYCLE_H
+
+#include <cstdint>
+#include "grid.h"
+
+// Longest period the detector can see
+const int CYCLE_HISTORY = 64;
+
+/* Zobrist hash of the whole board, the starting point for the per step
+ * updates the steppers and kernels return. */
+uint64_t board_hash(const Grid* grid);
+
+/* Ring of the last board hashes. A period is confirmed once the board has
+ * repeated it for a full period without any random tie-break, since a
+ * tie-break could send the next round somewhere else. */
+class CycleDetector {
+public:
+    CycleDetector();
+    /* Records the next generation, random when it needed a tie-break.
+     * Returns the period once confirmed, 0 until then. */
+    int push(uint64_t hash, bool random);
+    void reset();
+
+    int period() const;
+    int generation() const; // generations pushed after the first
+    int confirmedAt() const;
+private:
+    uint64_t at(int age) const;
+
+    uint64_t m_hashes[CYCLE_HISTORY];
+    bool m_random[CYCLE_HISTORY];
+    int m_count;
+    int m_candidate;
+    int m_streak;
+    int m_period;
+    int m_confirmedAt;
+};
+
+#endif
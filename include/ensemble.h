@@ -0,0 +1,131 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cl_platform.h"
+#include "cycle.h"
+#include "grid.h"
+#include "rule.h"
+#include "simulation.h"
+#include "stepper.h"
+
+typedef struct {
+    int width;
+    int height;
+    int species;
+    int density; // percent of cells alive at the start
+    uint64_t seed;
+} BoardSpec;
+
+enum class Outcome {
+    Running,
+    Limit,
+    Extinct,
+    Stasis,
+    Cycle
+};
+
+const char* outcome_name(Outcome outcome);
+
+// Cells of every board together, the most one launch can index
+const uint64_t MAX_ENSEMBLE_CELLS = 0xFFFFFFFFULL;
+
+typedef struct {
+    Outcome outcome;
+    int generations;
+    int period;     // of a detected cycle, 1 for stasis
+    int cycle_start; // generation the cycle was confirmed at
+    uint64_t initial_population;
+    uint64_t population;
+    uint64_t species[16];
+} BoardStats;
+
+/* "width,height,species,density,seed" per line, lines starting with
+ * anything but a digit are skipped */
+bool read_board_specs(const std::string& path, std::vector<BoardSpec>* specs);
+/* count boards sweeping species and density, seeds counting up from seed */
+std::vector<BoardSpec> sweep_board_specs(int count, int width, int height, uint64_t seed);
+
+/* Many independent boards packed into one buffer and stepped together, in
+ * a single NDRange or a single TBB pass per generation. Boards stop on
+ * their own once they die out or stop changing, and boards caught in a
+ * cycle only step far enough to land on the phase the limit would. */
+class Ensemble {
+public:
+    Ensemble(
+        const std::vector<BoardSpec>& specs,
+        Rule rule,
+        const SimulationSettings& settings
+    );
+    ~Ensemble();
+    Ensemble(const Ensemble&) = delete;
+    Ensemble& operator=(const Ensemble&) = delete;
+    // False when the boards have too many cells to step together or the kernel didn't build
+    bool ok() const;
+    void run(int generation_limit);
+    bool writeCsv(const std::string& path);
+    double cellsPerSecond() const;
+private:
+    /* Setup Functions */
+    void setupBoards();
+    void setupPlatform();
+    void setupKernels();
+    void setupBuffers();
+
+    void stepDevice(int generation);
+    void stepHost(int generation);
+    void finishBoard(int board, Outcome outcome, int generation);
+    void checkCycle(int board, int generation, int generation_limit);
+    void collectStats();
+    Grid view(int board, uint64_t* cells);
+
+    std::vector<BoardSpec> m_specs;
+    std::vector<BoardStats> m_stats;
+    Rule m_rule;
+    SimulationSettings m_settings;
+    double m_cellsPerSecond;
+    bool m_ok;
+
+    /* Board table */
+    std::vector<cl_ulong> m_offsets;  // first padded cell of every board
+    std::vector<cl_uint> m_starts;    // first interior cell, for the NDRange
+    std::vector<cl_int> m_widths;
+    std::vector<cl_uint> m_seeds;
+    std::vector<cl_uchar> m_active;
+    std::vector<cl_uint> m_changes;
+    std::vector<cl_uint> m_population;
+    std::vector<cl_uint> m_hashes;    // lo and hi half of every board hash
+    std::vector<cl_uint> m_ties;
+    std::vector<CycleDetector> m_detectors;
+    std::vector<int> m_fastForward;   // steps left to the limit's phase
+    size_t m_paddedCells;
+    cl_uint m_cells;
+
+    /* Host boards, the CPU backend steps these directly */
+    uint64_t* m_cellsIn;
+    uint64_t* m_cellsOut;
+    std::vector<CpuStepper*> m_steppers;
+
+    /* OpenCL objects */
+    cl_device_id m_device;
+    cl_context m_ctx;
+    cl_program m_program;
+    cl_command_queue m_queue;
+    cl_kernel m_kernel;
+    size_t m_localSize;
+    cl_mem m_inBuffer;
+    cl_mem m_outBuffer;
+    cl_mem m_offsetBuffer;
+    cl_mem m_startBuffer;
+    cl_mem m_widthBuffer;
+    cl_mem m_seedBuffer;
+    cl_mem m_activeBuffer;
+    cl_mem m_changeBuffer;
+    cl_mem m_populationBuffer;
+    cl_mem m_hashBuffer;
+    cl_mem m_tieBuffer;
+};
+
+#endif
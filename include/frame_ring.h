@@ -0,0 +1,77 @@
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include "grid.h"
+#include "viewport.h"
+
+// Frames a reader can fall behind before the one it's reading is reused
+const int FRAME_RING_SLOTS = 4;
+
+typedef struct {
+    uint64_t generation;
+    uint64_t population;
+    uint64_t hash;
+} FrameInfo;
+
+/* Every slot is a padded Grid behind a sequence number that is odd while
+ * the producer writes it (a seqlock). Readers map the same memory, read a
+ * slot in place and only trust what they read if the sequence is even and
+ * unchanged afterwards, so the producer never waits on anyone. */
+typedef struct {
+    std::atomic<uint64_t> sequence;
+    FrameInfo info;
+} SlotHeader;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t species;
+    int32_t slots;
+    uint64_t slot_bytes;
+    std::atomic<int64_t> latest; // newest complete slot, -1 before the first
+} RingHeader;
+
+/* A POSIX shared memory ring of board generations, one producer and any
+ * number of readers in other processes. */
+class FrameRing {
+public:
+    // Producer side, replaces any ring left behind under the same name
+    static FrameRing* create(const std::string& name, const Grid* grid);
+    // Reader side, nullptr when no server is publishing under name
+    static FrameRing* attach(const std::string& name);
+    ~FrameRing();
+
+    /* Producer: the slot the next frame goes to. Fill its cells between
+     * begin() and publish(). */
+    uint64_t* begin();
+    void publish(const FrameInfo& info);
+
+    /* Reader: reduces the region of the newest frame without copying it,
+     * retrying when the producer laps the slot mid read. False until the
+     * first frame is published. */
+    bool reduce(const Region& region, uint8_t* levels, FrameInfo* info);
+    // Reader: copies the newest frame into grid, which must match in size
+    bool read(Grid* grid, FrameInfo* info);
+
+    int width() const;
+    int height() const;
+    int species() const;
+private:
+    FrameRing(const std::string& name, void* memory, size_t bytes, bool owner);
+    SlotHeader* slot(int index) const;
+    Grid view(int index) const;
+
+    std::string m_name;
+    void* m_memory;
+    size_t m_bytes;
+    bool m_owner;
+    RingHeader* m_header;
+    int m_next;
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef FRONTIER_H
+#define FRONTIER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "oneapi/tbb/enumerable_thread_specific.h"
+#include "grid.h"
+#include "rule.h"
+#include "stepper.h"
+
+// Boards changing in fewer than one cell in this many step only the frontier
+const int FRONTIER_DIVISOR = 64;
+
+/* Steps only the cells around last generation's changes while the board is
+ * quiet and the whole board otherwise. Cells away from any change see the
+ * same neighbourhood as last generation, so they can't change either. It
+ * relies on out still holding the generation before in, as it does when
+ * the caller swaps the two after every step. */
+class FrontierStepper {
+public:
+    FrontierStepper(int species, Rule rule, int width, int height);
+    /* observe, when given, is called once for every band of band rows. A
+     * dense step calls it right after stepping the band, while its rows
+     * are still in cache, a frontier step in a pass of its own. Without
+     * it, band is the grain of a dense step. */
+    StepStats step(const Grid* in, Grid* out, uint64_t seed, const RowObserver& observe = nullptr, int band = 1);
+    // The board was changed outside step(), the next step is dense
+    void invalidate();
+    /* Only the rectangle was changed outside step(), by population cells.
+     * Its cells join the frontier so the next step can stay sparse. */
+    void edit(int x, int y, int width, int height, int64_t population);
+
+    bool specialized() const;
+    bool sparse() const; // the last step only visited the frontier
+private:
+    StepStats stepDense(const Grid* in, Grid* out, uint64_t seed, const RowObserver& observe, int band);
+    StepStats stepFrontier(const Grid* in, Grid* out, uint64_t seed);
+    void collect(const Grid* in, const Grid* out);
+    void merge();
+
+    CpuStepper m_stepper;
+    int m_width;
+    int m_height;
+    bool m_valid;
+    bool m_sparse;
+    uint64_t m_population;
+
+    std::vector<uint32_t> m_changes; // cells that changed last generation, boards in memory stay under 2^32
+    tbb::enumerable_thread_specific<std::vector<uint32_t>> m_buffers;
+    std::unique_ptr<std::atomic<uint32_t>[]> m_stamps; // last frontier step a cell was claimed in
+    uint32_t m_stamp;
+};
+
+#endif
@@ -1,69 +1,89 @@
-#include <random>
+//#define DEBUG_MODE
 #include <vector>
 #include <oneapi/tbb/concurrent_vector.h>
 #include "GL/glew.h"
+#include "counters.h"
+#include "frame_ring.h"
 #include "grid.h"
-
-#define CL_TARGET_OPENCL_VERSION 120
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wnullability-completeness-on-arrays"
-#include <OpenCL/opencl.h>
-#pragma clang diagnostic pop
+#include "history.h"
+#include "pattern.h"
+#include "rule.h"
+#include "simulation.h"
+#include "viewport.h"
 
 struct Vertex {
     GLfloat position[2];
     GLubyte color[4];
-    GLubyte _pad[4]; // Padding for OpenCL
 };
 
 class GameOfLife {
 public:
     GameOfLife(
-        Grid* grid
+        Grid* grid,
+        Rule rule,
+        const SimulationSettings& settings,
+        int screen_width,
+        int screen_height,
+        float point_scale,
+        size_t history_bytes = 0
+    );
+    // Only draws the frames another process publishes to ring
+    GameOfLife(
+        FrameRing* ring,
+        int screen_width,
+        int screen_height,
+        float point_scale
     );
-    cl_uint step();
+    // Frees the simulation, history and GL buffers, a frame ring stays with its owner
+    ~GameOfLife();
+    // False when the simulation couldn't be set up, a frame ring is always ok
+    bool ok() const;
+    // Draws the board, stepping it first unless paused
+    cl_uint step(const Region& region);
+    void setPaused(bool paused);
+    /* Moves through the retained generations and pauses there, stepping
+     * past the newest one. False when there's no history to move through. */
+    bool travel(int64_t generations);
+    /* Queues pattern centred on cell (x, y) in species, 0 to erase its
+     * cells. Edits land before the next frame, paused or not. */
+    void stamp(int x, int y, const Pattern& pattern, int species, bool transparent);
+    void clear(int x, int y, int width, int height);
+    // nullptr when drawing from a frame ring
+    const Simulation* simulation() const;
+    // nullptr without a history budget
+    const History* history() const;
+    // Counts each phase of every frame into counters, nullptr stops counting
+    void setCounters(PerfCounters* counters);
 private:
     /* Setup Functions */
-    void setupGame(Grid* grid);
-    void setupPlatform();
-    void setupKernels();
+    void setupPlatform(Grid* grid, Rule rule, const SimulationSettings& settings);
     void setupBuffers();
 
     /* Recompute functions */
-    cl_uint ParallelStep();
-    void swap();
+    cl_uint ParallelStep(const Region& region);
 
     /* Game Specific Variables */
-    float m_point_width_offset;
-    float m_point_height_offset;
+    int m_screen_width;
+    int m_screen_height;
+    float m_point_scale;
     int m_num_vertices;
-    bool m_firstFrame;
-    std::mt19937_64 m_rng;
-    std::uniform_int_distribution<uint64_t> m_dist;
+    int m_drawn_vertices;
 
-
-    /* OpenCL objects */
-    cl_device_id m_device;
-    cl_context m_ctx;
-    cl_program m_program;
-    cl_command_queue m_queue;
-    cl_kernel m_gameKernel;
-    cl_kernel m_debugKernel;
+    Simulation* m_simulation;
+    History* m_history;
+    bool m_paused;
+    std::vector<uint64_t> m_stamp; // cells of the pattern being stamped
+    FrameRing* m_ring;
+    FrameInfo m_frame;
+    PerfCounters* m_counters;
 
     /* Buffers */
-    Grid* m_grid;
-    Grid* m_next;
     GLuint m_VBO;
     GLuint m_VAO;
     Vertex* m_vertices;
-    cl_mem m_inBuffer;
-    cl_mem m_outBuffer;
-    cl_mem m_vertexBuffer;
-    cl_mem m_totalVertices;
-    cl_mem m_mistakeCount;
+    cl_uchar* m_levels; // dominant species and density per drawn point
 
 
 
 
 };
-
@@ -0,0 +1,82 @@
+#ifndef GOL_H
+#define GOL_H
+
+/* C API of the gol library, the simulator without any windowing or GL.
+ * Functions returning int give 0 on success and -1 on failure, with the
+ * reason in gol_last_error(). Boards aren't thread safe, but separate
+ * boards can be used from separate threads.
+ *
+ *     gol_board* board = gol_create(1024, 1024, 5, "B3/S23", GOL_BACKEND_CPU, 42);
+ *     gol_step(board, 100);
+ *     size_t stride;
+ *     const uint64_t* cells = gol_cells(board, &stride);
+ *     // cell (x, y) is cells[y * stride + x], one 4 bit count per species
+ *     gol_destroy(board);
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GOL_API_VERSION 2
+
+typedef struct gol_board gol_board;
+
+typedef enum {
+    GOL_BACKEND_OPENCL = 0,
+    GOL_BACKEND_CPU = 1
+} gol_backend;
+
+typedef struct {
+    uint64_t generation;
+    uint64_t population; // cells with any species
+    uint64_t hash;       // Zobrist hash of the board
+    int period;          // confirmed cycle length, 0 while none is known
+} gol_stats;
+
+int gol_api_version(void);
+const char* gol_last_error(void);
+
+/* A board seeded the same way as the game for the same seed, which also
+ * drives tie-breaks, with sides up to 32768. rule is B/S notation, NULL
+ * for Conway's. */
+gol_board* gol_create(int width, int height, int species, const char* rule, gol_backend backend, uint64_t seed);
+// A board saved with gol_save, or one stepped out of core that fits in memory
+gol_board* gol_load(const char* path, gol_backend backend);
+void gol_destroy(gol_board* board);
+
+/* Reseeds at generation 0, density in percent or 0 for the species default.
+ * Tie-breaks keep the seed the board was created with, and that is the seed
+ * gol_save records, so a saved board reloads stepping the same way. */
+int gol_seed(gol_board* board, int density, uint64_t seed);
+int gol_step(gol_board* board, int generations);
+int gol_stats_get(gol_board* board, gol_stats* stats);
+int gol_save(gol_board* board, const char* path);
+
+/* Writes cells row by row into the width x height rectangle at (x, y),
+ * clipped to the board, or clears it when cells is NULL. Cells holding
+ * UINT64_MAX keep what's there. Edits are batched until the board is next
+ * stepped or read, each costing only its own rectangle. */
+int gol_edit(gol_board* board, int x, int y, int width, int height, const uint64_t* cells);
+/* Stamps an RLE pattern in species with its bottom left cell at (x, y),
+ * its first row landing on the highest row as the game draws it */
+int gol_stamp(gol_board* board, int x, int y, const char* rle, int species);
+
+/* The current generation in place, no copy: the first cell of the board,
+ * with stride cells from one row to the next. Only valid until the board
+ * is stepped, seeded or destroyed. */
+const uint64_t* gol_cells(gol_board* board, size_t* stride);
+
+int gol_width(const gol_board* board);
+int gol_height(const gol_board* board);
+int gol_species(const gol_board* board);
+gol_backend gol_get_backend(const gol_board* board);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
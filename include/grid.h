@@ -1,6 +1,10 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
 #include <vector>
-#include "GL/glew.h"
-#include "GLFW/glfw3.h"
 
 typedef struct {
     int height;
@@ -9,13 +13,26 @@ typedef struct {
     uint64_t* arr;
 } Grid;
 
+// Largest side of a board held in memory, cell indices stay under 2^32
+const int MAX_BOARD_SIZE = 32768;
+
+// Edit cells holding this keep the board's cell, no valid cell has every species
+const uint64_t EDIT_KEEP = ~0ULL;
+
 void clear(Grid* grid);
 void set(Grid* grid, int x, int y, uint64_t value);
 uint64_t check(Grid* grid, int x, int y);
 int get_active_points(Grid* grid);
 size_t size(Grid* grid);
 
+// An empty board, seed it with grid_seed
 Grid* grid_init(int width, int height, int species);
+void grid_free(Grid* grid);
+/* Clears the grid and fills density percent of it, the same way for the same seed */
+void grid_seed(Grid* grid, int density, uint64_t seed);
+// One row of grid_seed, for boards seeded a row at a time from one generator
+void seed_row(uint64_t* row, int width, int species, int density, std::mt19937_64* rng);
+int default_density(int species);
 
 /*
 class Grid {
@@ -34,3 +51,4 @@ private:
 };
 */
 
+#endif
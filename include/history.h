@@ -0,0 +1,75 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "grid.h"
+
+// Generations between keyframes, so a seek applies at most half this many deltas
+const int HISTORY_KEYFRAME_INTERVAL = 64;
+// Most generations kept however small their deltas, still boards cost next to nothing
+const int HISTORY_MAX_GENERATIONS = 1 << 16;
+
+/* Bounded record of past generations to rewind through. Every generation is
+ * a sparse delta, the cells that changed and their old value XOR the new,
+ * so the same delta steps either way. Every interval generations there's a
+ * keyframe of the whole board too. Both live in one arena allocated up
+ * front and used as a ring, nothing is allocated per generation. When it
+ * fills, the oldest keyframe and the deltas up to the next one go first. */
+class History {
+public:
+    History(const Grid* grid, uint64_t generation, size_t bytes, int interval = HISTORY_KEYFRAME_INTERVAL);
+    ~History();
+    // False when the budget can't hold a few boards
+    bool ok() const;
+    /* Records grid as generation. It normally follows the generation last
+     * pushed or sought and drops any retained after that one, anything else
+     * starts the history over from grid. */
+    void push(const Grid* grid, uint64_t generation);
+    /* Rebuilds a retained generation in board() from whichever is fewest
+     * deltas away: the current generation or the keyframes either side of
+     * the one wanted. False when it isn't retained. */
+    bool seek(uint64_t generation);
+
+    const Grid* board() const; // the generation last pushed or sought
+    uint64_t generation() const;
+    uint64_t oldest() const;
+    uint64_t newest() const;
+    size_t used() const; // arena bytes holding retained records
+private:
+    typedef struct {
+        uint64_t generation;
+        size_t offset;
+        size_t bytes;
+        uint32_t cells; // changed cells, 0 for a keyframe
+        bool keyframe;
+    } Entry;
+
+    Entry& entry(size_t index);
+    const Entry& entry(size_t index) const;
+    size_t find(uint64_t generation, bool keyframe) const;
+    size_t allocate(size_t bytes);
+    void append(const Entry& record);
+    void evict();
+    void truncate(uint64_t generation);
+    void reset(const Grid* grid, uint64_t generation);
+    void keyframe();
+    void apply(const Entry& delta);
+
+    Grid* m_board;
+    uint64_t m_generation;
+    int m_interval;
+    bool m_ok;
+
+    std::unique_ptr<unsigned char[]> m_arena;
+    size_t m_capacity;
+    size_t m_tail; // where the newest record ends
+    std::vector<Entry> m_entries; // ring of records, oldest at m_first
+    size_t m_first;
+    size_t m_count;
+    std::vector<uint32_t> m_bandCells; // changed cells per band of the delta being pushed
+};
+
+#endif
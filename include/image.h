@@ -0,0 +1,12 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <cstdint>
+#include <string>
+
+/* Writes RGBA pixels as a PNG. The deflate stream uses stored blocks only,
+ * which costs disk space but no compression time and no zlib. Rows are
+ * given bottom up, the way glReadPixels returns them. */
+bool write_png(const std::string& path, const uint8_t* rgba, int width, int height);
+
+#endif
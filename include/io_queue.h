@@ -0,0 +1,32 @@
+#ifndef IO_QUEUE_H
+#define IO_QUEUE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/* Single I/O thread running jobs in the order they were queued, so a job
+ * never overtakes one queued before it. wait() blocks until the job with
+ * that ticket and everything before it is done. */
+class IoQueue {
+public:
+    IoQueue();
+    ~IoQueue();
+    uint64_t push(std::function<void()> job);
+    void wait(uint64_t ticket);
+private:
+    void run();
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::deque<std::function<void()>> m_jobs;
+    uint64_t m_queued;
+    uint64_t m_done;
+    bool m_stopping;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cl_platform.h"
+#include "grid.h"
+#include "rule.h"
+
+// Every device of every platform, in the order settings.device counts them
+std::vector<cl_device_id> list_devices();
+/* The index-th device of list_devices(), the first device of the first
+ * platform when out of range, nullptr without OpenCL */
+cl_device_id select_device(int index = 0);
+// Name and driver version, what the tuned profile is keyed by
+std::string device_name(cl_device_id device);
+
+// FNV-1a starting value, what keys are built up from
+const uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+/* Folds text into an FNV-1a hash, followed by a separator so ("ab", "c")
+ * and ("a", "bc") differ. Keys the kernel cache and the tuned profile. */
+uint64_t fnv1a(uint64_t hash, const std::string& text);
+
+/* OpenCL source for every kernel. Board size, species count and rule are
+ * not kernel arguments but -D build options, see kernel_options. validate
+ * adds the cell checks to stepFrame. */
+std::string kernel_source();
+std::string kernel_options(const Grid* grid, Rule rule, bool validate = false);
+
+/* Source and options for stepping many packed boards at once */
+std::string ensemble_kernel_source();
+std::string ensemble_kernel_options(Rule rule);
+
+/* Builds the program for one device. With use_cache the binary is kept on
+ * disk (GOL_KERNEL_CACHE, or ~/.cache/game-of-life) keyed by a hash of the
+ * device, driver, source and options, and reused on the next launch.
+ * Returns nullptr if the source doesn't build. */
+cl_program build_program(
+    cl_context ctx,
+    cl_device_id device,
+    const std::string& source,
+    const std::string& options,
+    bool use_cache
+);
+
+#endif
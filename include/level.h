@@ -0,0 +1,34 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <cstdint>
+#include "grid.h"
+#include "viewport.h"
+
+/* Host version of the reduceLevel kernel: two bytes per drawn point of the
+ * region, the dominant species (0 when empty) and the density (0-255). */
+void reduce_level(const Grid* grid, const Region& region, uint8_t* levels);
+// Single threaded, only the region's point rows in [row_begin, row_end)
+void reduce_level_rows(const Grid* grid, const Region& region, int row_begin, int row_end, uint8_t* levels);
+
+/* Live cells of a generation by species, and with validation the cells
+ * holding anything other than exactly one species of a valid nibble */
+typedef struct {
+    uint32_t population;
+    uint32_t species[16];
+    uint32_t invalid;
+} SpeciesCounts;
+
+inline SpeciesCounts operator+(SpeciesCounts a, const SpeciesCounts& b) {
+    a.population += b.population;
+    for (int s = 0; s < 16; s++) {
+        a.species[s] += b.species[s];
+    }
+    a.invalid += b.invalid;
+    return a;
+}
+
+// Adds the cells of rows [y_begin, y_end) to counts
+void count_species(const Grid* grid, int y_begin, int y_end, bool validate, SpeciesCounts* counts);
+
+#endif
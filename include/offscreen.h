@@ -0,0 +1,61 @@
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include "GL/glew.h"
+#include "io_queue.h"
+
+// Frames in flight between drawing and mapping their pixels
+const int RECORD_PBOS = 3;
+// Frames waiting on the writer before drawing stalls
+const int RECORD_BACKLOG = 4;
+
+/* Headless GL context on EGL, surfaceless when the driver allows it and a
+ * small pbuffer otherwise, so Mesa's software rasteriser works too. False
+ * when there's no EGL display or the build has no EGL. */
+bool offscreen_init();
+void offscreen_terminate();
+
+/* Renders into an FBO and reads every frame back through a ring of PBOs,
+ * mapping a frame only once the frames after it are drawn. Frames go to
+ * numbered PNGs in a directory, raw RGBA to a file or stdout ("-"), or raw
+ * RGBA piped to an encoder ("|ffmpeg -f rawvideo ..."). */
+class FrameRecorder {
+public:
+    FrameRecorder(int width, int height, const std::string& target);
+    ~FrameRecorder();
+    bool ok() const;
+
+    void begin();
+    void end();
+    // Waits for every frame to be written, false when any were lost
+    bool finish();
+    int frames() const;
+private:
+    void collect();
+
+    int m_width;
+    int m_height;
+    bool m_ok;
+    std::string m_directory;
+    FILE* m_stream;
+    bool m_pipe;
+
+    GLuint m_fbo;
+    GLuint m_color;
+    GLuint m_pbos[RECORD_PBOS];
+    GLsync m_fences[RECORD_PBOS];
+    int m_drawn;
+    int m_collected;
+    std::atomic<int> m_lost; // frames the writer thread failed to write
+    bool m_reported;
+
+    IoQueue m_io;
+    std::deque<uint64_t> m_tickets;
+};
+
+#endif
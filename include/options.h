@@ -0,0 +1,43 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+#include "history.h"
+#include "out_of_core.h"
+#include "rule.h"
+#include "simulation.h"
+
+const int MAX_SPECIES = 16;
+
+typedef struct {
+    int species;
+    int board_width;
+    int board_height;
+    Rule rule;
+    SimulationSettings settings;
+    std::string batch;  // spec file or board count, empty when interactive
+    std::string stats;  // where batch statistics go
+    int generations;    // 0 runs until interrupted
+    std::string serve;  // shared memory name to publish frames under
+    int every;          // publish every Nth generation
+    std::string attach; // shared memory name to draw frames from
+    std::string check;  // two backends to step side by side, "opencl,cpu"
+    std::string out_of_core; // board file to step from disk
+    size_t window;      // bytes of band buffers for an out of core board
+    bool offscreen;     // render with no window, as fast as the GPU goes
+    std::string record; // where offscreen frames go, empty to only time them
+    size_t history;     // bytes of generations kept to rewind through, 0 for none
+    std::string pattern; // RLE pattern E stamps, empty for none
+    bool autotune;      // time the backends on this board and save the fastest
+    bool perf;          // count cycles and misses of each CPU side phase
+} Options;
+
+/* species [--force] [--size WxH] [--rule B3/S23] [--backend opencl|cpu]
+ * [--device N] [--no-kernel-cache] [--validate] [--in-place] [--batch specs.csv|COUNT]
+ * [--generations N] [--stats out.csv] [--serve NAME [--every N]] [--attach NAME]
+ * [--seed N] [--check BACKEND,BACKEND] [--out-of-core FILE [--window MB]]
+ * [--offscreen [--record DIR|FILE.rgba|-|'|COMMAND']] [--history MB] [--pattern FILE.rle]
+ * [--autotune] [--no-profile] [--perf] */
+Options parse_options(int argc, char* argv[], int board_width, int board_height);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef OUT_OF_CORE_H
+#define OUT_OF_CORE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "grid.h"
+#include "io_queue.h"
+#include "rule.h"
+#include "stepper.h"
+
+// Boards stepped from a file can be far past MAX_BOARD_SIZE
+const int MAX_OUT_OF_CORE_SIZE = 1 << 22;
+// Default memory for the band buffers, in bytes
+const size_t DEFAULT_WINDOW_BYTES = size_t(256) << 20;
+
+/* Start of a board file, followed by the padded grid in the usual row major
+ * (y+1)*(width+2)+(x+1) layout. Padded to a page so rows start at a fixed
+ * offset. */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t species;
+    uint16_t birth;
+    uint16_t survive;
+    uint64_t seed;
+    uint64_t generation;
+    uint64_t population;
+    uint64_t hash;
+} BoardFileHeader;
+
+/* Board files for boards that fit in memory, so a board saved whole can be
+ * stepped out of core and the other way round. save_board fills in the
+ * magic and version, load_board returns nullptr for anything else. */
+bool save_board(const std::string& path, const BoardFileHeader& header, const Grid* grid);
+Grid* load_board(const std::string& path, BoardFileHeader* header);
+
+/* A board too large for memory, kept in a memory mapped file and stepped
+ * in place one band of rows at a time. The I/O thread loads the next band
+ * and writes back the last one while the current band steps, and the old
+ * last row of every band is kept aside as the halo of the next. A board
+ * interrupted mid generation has to be recreated. */
+class OutOfCoreBoard {
+public:
+    static OutOfCoreBoard* create(const std::string& path, int width, int height, int species, Rule rule, uint64_t seed);
+    static OutOfCoreBoard* open(const std::string& path);
+    ~OutOfCoreBoard();
+
+    void setWindow(size_t bytes);
+    StepStats step();
+
+    const BoardFileHeader& header() const;
+    int bandRows() const;
+private:
+    OutOfCoreBoard(const std::string& path, void* memory, size_t bytes);
+    uint64_t* row(int64_t padded_y) const;
+    void load(int band, uint64_t* buffer);
+    void store(int band, const uint64_t* buffer);
+
+    std::string m_path;
+    void* m_memory;
+    size_t m_bytes;
+    BoardFileHeader* m_header;
+    size_t m_rowCells;
+    int m_bandRows;
+    CpuStepper* m_stepper;
+    IoQueue m_io;
+
+    std::vector<uint64_t> m_in[2];
+    std::vector<uint64_t> m_out[2];
+    std::vector<uint64_t> m_saved; // old last row of the band before
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "grid.h"
+
+// Largest pattern read, in cells
+const int MAX_PATTERN_CELLS = 1 << 24;
+
+/* Cells to stamp onto a board, row major from the top row down as patterns
+ * are written. 0 is empty and state n is the nth species counting from the
+ * one it's stamped in, so two state patterns come out in a single species. */
+typedef struct {
+    int width;
+    int height;
+    std::vector<uint8_t> cells;
+} Pattern;
+
+/* Run length encoded pattern, the format most pattern collections use.
+ * Multi-state patterns (.ABC) keep their states. False when malformed. */
+bool parse_rle(const std::string& text, Pattern* pattern);
+bool read_rle(const std::string& path, Pattern* pattern);
+// Filled disc of cells up to radius away from its centre
+Pattern brush_pattern(int radius);
+
+/* Board cells for pattern in species, bottom row first since boards are
+ * drawn bottom up. Species 0 erases the pattern's cells instead. Empty
+ * cells keep what's on the board when transparent and clear it otherwise. */
+void pattern_cells(const Pattern& pattern, int species, int board_species, bool transparent, uint64_t* cells);
+
+#endif
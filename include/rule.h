@@ -0,0 +1,19 @@
+#ifndef RULE_H
+#define RULE_H
+
+#include <cstdint>
+#include <string>
+
+/* Life-like birth/survival rule, bit n set means n neighbours of the
+ * cell's own species. Birth with zero neighbours (B0) isn't supported. */
+typedef struct {
+    uint16_t birth;
+    uint16_t survive;
+} Rule;
+
+const Rule CONWAY = { 1 << 3, 1 << 2 | 1 << 3 };
+
+bool parse_rule(const std::string& text, Rule* rule);
+std::string rule_string(Rule rule);
+
+#endif
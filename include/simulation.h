@@ -0,0 +1,168 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <string>
+#include <vector>
+#include "cl_platform.h"
+#include "cycle.h"
+#include "frontier.h"
+#include "grid.h"
+#include "level.h"
+#include "rule.h"
+#include "stepper.h"
+#include "viewport.h"
+
+enum class Backend {
+    OpenCL,
+    CPU
+};
+
+bool parse_backend(const std::string& text, Backend* backend);
+const char* backend_name(Backend backend);
+
+typedef struct {
+    Backend backend;
+    bool kernel_cache; // reuse compiled OpenCL binaries across launches
+    uint64_t seed;     // tie-breaks, the same seed replays the same run
+    bool validate;     // frame() checks every cell holds at most one species
+    bool in_place;     // one board instead of two, stepped in place
+    /* What --autotune picks per host, the defaults below leave it to the
+     * driver and TBB */
+    int device;        // index into list_devices()
+    bool fused;        // frames use stepFrame rather than separate passes
+    int local_size;    // work items per group of the per cell kernels, 0 for the driver's choice
+    int band;          // rows per CPU task, 0 for each stepper's own
+} SimulationSettings;
+
+const SimulationSettings DEFAULT_SETTINGS = { Backend::OpenCL, true, 0, false, false, 0, true, 0, 0 };
+
+// Cells per side of the tiles the kernel marks dirty, matches TILE
+const int SYNC_TILE = 32;
+/* Cells per side of a stepFrame work group, matches FRAME_TILE. Regions
+ * zoomed out further than this many cells per point are reduced in a pass
+ * of their own. The CPU frame steps bands of at least this many rows. */
+const int FRAME_TILE = 16;
+// Rows per band of a CPU board stepped in place, two of them are saved per band
+const int IN_PLACE_BAND = 64;
+/* Cells per side of the tiles stepped in place on a device, matches
+ * IN_PLACE_TILE, with IN_PLACE_ROWS cells per work item */
+const int IN_PLACE_TILE = 32;
+const int IN_PLACE_ROWS = 4;
+
+/* A board and the engine that steps it, without any rendering. With the
+ * OpenCL backend the host grid is a mirror that only sync() updates.
+ * The board hash and cycle detector are up to date after finish(). The
+ * simulation owns the grid it's given. In place, the CPU backend keeps
+ * one grid and no frontier, and the device one buffer plus tile borders. */
+class Simulation {
+public:
+    Simulation(
+        Grid* grid,
+        Rule rule,
+        const SimulationSettings& settings,
+        const cl_context_properties* properties = nullptr
+    );
+    ~Simulation();
+    // False when the OpenCL backend couldn't build its kernels
+    bool ok() const;
+    void step();
+    /* step() that also fills the region's levels and the species counts of
+     * the generation it steps from, in the same read of the board. Returns
+     * that generation's population, like count(). */
+    cl_uint frame(const Region& region, cl_uchar* levels);
+    cl_uint count();
+    void reduce(const Region& region, cl_uchar* levels);
+    /* Brings grid() up to the current generation, fetching only the tiles
+     * that changed since the last sync. Returns the bytes read back. */
+    size_t sync();
+    // Copies the current generation, halo included, into a Grid sized buffer
+    void read(uint64_t* cells);
+    /* Replaces the board, halo included, and carries on from generation.
+     * The cycle detector starts over. */
+    void load(const uint64_t* cells, uint64_t generation);
+    /* Queues cells for the width x height rectangle at (x, y), row by row
+     * and clipped to the board, nullptr to clear it. Queued edits land
+     * together before the next step, a device gets one rectangle read and
+     * write per edit rather than the whole board. */
+    void edit(int x, int y, int width, int height, const uint64_t* cells);
+    // Lands the queued edits now rather than at the next step
+    void applyEdits();
+    void finish();
+
+    Grid* grid();
+    uint64_t hash() const;
+    uint64_t generation() const;
+    // What the last frame() counted
+    const SpeciesCounts& counts() const;
+    const CycleDetector& cycles() const;
+    Backend backend() const;
+    cl_context context() const;
+private:
+    /* Setup Functions */
+    void setupPlatform(const cl_context_properties* properties);
+    void setupKernels();
+    void setupBuffers();
+
+    void stepInPlace(uint64_t seed);
+    void swap();
+    void record(uint64_t hash, uint64_t ties);
+    void reserveLevels(size_t points);
+    size_t launchSize(size_t cells, const size_t** local) const;
+    void report(const cl_uint* counts);
+
+    typedef struct {
+        int x;
+        int y;
+        int width;
+        int height;
+        size_t offset; // first cell in m_editCells, SIZE_MAX to clear
+    } Edit;
+
+    /* Simulation Specific Variables */
+    Backend m_backend;
+    SimulationSettings m_settings;
+    Rule m_rule;
+    uint64_t m_generation;
+    FrontierStepper* m_stepper;
+    CpuStepper* m_inPlace;
+    uint64_t m_hash;
+    CycleDetector m_cycles;
+    bool m_pending; // a device step whose hash hasn't been recorded
+    SpeciesCounts m_counts;
+    std::vector<Edit> m_edits;
+    std::vector<uint64_t> m_editCells;
+
+    /* OpenCL objects */
+    cl_device_id m_device;
+    cl_context m_ctx;
+    cl_program m_program;
+    cl_command_queue m_queue;
+    cl_kernel m_gameKernel;
+    cl_kernel m_countKernel;
+    cl_kernel m_levelKernel;
+    cl_kernel m_frameKernel; // nullptr when the device can't fit a FRAME_TILE square group or frames aren't fused
+    cl_kernel m_saveKernel;
+    cl_kernel m_inPlaceKernel;
+
+    /* Buffers */
+    Grid* m_grid;
+    Grid* m_next; // only for the CPU backend stepping between two grids
+    int m_levelCapacity;
+    cl_mem m_inBuffer;
+    cl_mem m_outBuffer;
+    cl_mem m_levelBuffer;
+    cl_mem m_totalVertices;
+    cl_mem m_hashBuffer;
+    cl_mem m_tieBuffer;
+    cl_mem m_dirtyBuffer;
+    cl_mem m_countsBuffer;
+    cl_mem m_borderBuffer;
+    std::vector<cl_uint> m_dirty;
+    int m_tilesX;
+    int m_tilesY;
+    cl_uint m_hashHalves[2];
+    cl_uint m_ties;
+    size_t m_localSize;
+};
+
+#endif
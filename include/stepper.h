@@ -0,0 +1,252 @@
+#ifndef STEPPER_H
+#define STEPPER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "grid.h"
+#include "rule.h"
+
+/* CPU stepper, specialised at compile time on the species count and the
+ * birth/survival rule so the neighbour tests unroll into constant masks.
+ * Every species owns a 4-bit nibble of a cell, so adding up the eight
+ * neighbours counts all species at once. */
+
+const uint64_t SPECIES_VALUE_MASK = 0x1111111111111111ULL;
+
+template <uint16_t Birth, uint16_t Survive>
+struct StaticRule {
+    static constexpr uint16_t birth = Birth;
+    static constexpr uint16_t survive = Survive;
+    static StaticRule make(Rule) { return StaticRule(); }
+};
+
+struct DynamicRule {
+    uint16_t birth;
+    uint16_t survive;
+    static DynamicRule make(Rule rule) { return DynamicRule{ rule.birth, rule.survive }; }
+};
+
+// https://www.reedbeta.com/blog/hash-functions-for-gpu-rendering/
+inline uint32_t pcg_hash(uint32_t input) {
+    uint32_t state = input * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+/* Tie-break seed of a generation. The kernels and steppers hash it with
+ * the cell index, so a run depends only on (seed, generation, x, y). */
+inline uint64_t generation_seed(uint64_t seed, uint64_t generation) {
+    uint64_t z = seed + (generation + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* Tie-break hash input of a cell. Out of core boards pass 2^32 cells, their
+ * high index bits are folded in so tie-breaks don't repeat every 2^32
+ * cells, below that it's the low bits as the kernels use them. */
+inline uint32_t tie_input(uint64_t seed, uint64_t cell) {
+    return uint32_t(seed) ^ uint32_t(cell) ^ uint32_t(cell >> 32) * 0x9E3779B9u;
+}
+
+/* Zobrist key of a cell holding value, zero for empty cells. The board
+ * hash is the XOR of the keys of every live cell, so a step only has to
+ * XOR in the old and new key of the cells that changed. */
+inline uint64_t zobrist(uint64_t cell, uint64_t value) {
+    if (!value) {
+        return 0;
+    }
+    uint64_t z = cell * 0x9E3779B97F4A7C15ULL ^ value * 0xC2B2AE3D27D4EB4FULL;
+    z ^= z >> 33;
+    z *= 0xFF51AFD7ED558CCDULL;
+    z ^= z >> 33;
+    z *= 0xC4CEB9FE1A85EC53ULL;
+    z ^= z >> 33;
+    return z;
+}
+
+template <int Species>
+constexpr uint64_t species_mask() {
+    return Species >= 16 ? SPECIES_VALUE_MASK : SPECIES_VALUE_MASK & ((1ULL << (Species * 4)) - 1);
+}
+
+// Low bit of every species nibble whose neighbour count is in the set
+template <int Species>
+inline uint64_t counts_in(uint64_t neighbors, uint16_t set) {
+    uint64_t result = 0;
+    for (int n = 0; n <= 8; n++) {
+        if (set & (1u << n)) {
+            uint64_t x = neighbors ^ (SPECIES_VALUE_MASK * n);
+            x = (x | x >> 1 | x >> 2 | x >> 3) & SPECIES_VALUE_MASK;
+            result |= x ^ SPECIES_VALUE_MASK;
+        }
+    }
+    return result & species_mask<Species>();
+}
+
+template <int Species, class R>
+inline uint64_t next_cell(uint64_t value, uint64_t neighbors, uint32_t rng_input, const R& rule, uint64_t& ties) {
+    if (value) {
+        return (counts_in<Species>(neighbors, rule.survive) & value) ? value : 0;
+    }
+    if (!neighbors) {
+        return 0;
+    }
+    uint64_t born = counts_in<Species>(neighbors, rule.birth);
+    if (!(born & (born - 1))) {
+        return born;
+    }
+
+    // Several species qualify, pick one (same choice as the OpenCL kernel)
+    ties++;
+    uint32_t pick = pcg_hash(rng_input) % __builtin_popcountll(born);
+    for (; pick; pick--) {
+        born &= born - 1;
+    }
+    return born & (~born + 1);
+}
+
+typedef struct {
+    uint64_t changed;
+    uint64_t population;
+    uint64_t hash; // XOR to apply to the board hash
+    uint64_t ties; // births decided by the random tie-break
+} StepStats;
+
+inline StepStats operator+(StepStats a, StepStats b) {
+    return StepStats{ a.changed + b.changed, a.population + b.population, a.hash ^ b.hash, a.ties + b.ties };
+}
+
+/* Steps one row. Pointers are to the first real cell of each padded row,
+ * so [-1] and [width] are the halo. gid is the y * width offset of the
+ * row, matching get_global_id in the kernel. */
+template <int Species, class R>
+StepStats step_row(
+    const uint64_t* above,
+    const uint64_t* row,
+    const uint64_t* below,
+    uint64_t* out,
+    int width,
+    uint64_t gid,
+    uint64_t seed,
+    const R& rule
+) {
+    // Column sums stay under 10 per nibble, so three of them can't carry
+    uint64_t left = above[-1] + row[-1] + below[-1];
+    uint64_t middle = above[0] + row[0] + below[0];
+    StepStats stats = { 0, 0, 0, 0 };
+    for (int x = 0; x < width; x++) {
+        uint64_t right = above[x+1] + row[x+1] + below[x+1];
+        uint64_t value = row[x];
+        uint64_t neighbors = left + middle + right - value;
+        uint64_t next = next_cell<Species>(value, neighbors, tie_input(seed, gid + x), rule, stats.ties);
+        out[x] = next;
+        if (next != value) {
+            stats.changed++;
+            stats.hash ^= zobrist(gid + x, value) ^ zobrist(gid + x, next);
+        }
+        stats.population += next != 0;
+        left = middle;
+        middle = right;
+    }
+    return stats;
+}
+
+template <int Species, class R>
+StepStats step_rows(const Grid* in, Grid* out, int y_begin, int y_end, uint64_t seed, Rule rule, int row_offset) {
+    R r = R::make(rule);
+    size_t dx = in->width + 2;
+    StepStats stats = { 0, 0, 0, 0 };
+    for (int y = y_begin; y < y_end; y++) {
+        const uint64_t* row = in->arr + (y+1) * dx + 1;
+        stats = stats + step_row<Species>(row - dx, row, row + dx, out->arr + (y+1) * dx + 1, in->width, uint64_t(y + row_offset) * in->width, seed, r);
+    }
+    return stats;
+}
+
+/* Steps only the listed cells, given as y * width + x, and appends the ones
+ * that changed to changed. Population counts the births among them, every
+ * other change is a death. */
+template <int Species, class R>
+StepStats step_cells(const Grid* in, Grid* out, const uint32_t* cells, size_t count, uint64_t seed, Rule rule, std::vector<uint32_t>* changed) {
+    R r = R::make(rule);
+    int dx = in->width + 2;
+    StepStats stats = { 0, 0, 0, 0 };
+    for (size_t c = 0; c < count; c++) {
+        uint32_t cell = cells[c];
+        int i = (cell / in->width + 1) * dx + (cell % in->width + 1);
+        const uint64_t* p = in->arr + i;
+        uint64_t value = p[0];
+        uint64_t neighbors = p[-dx-1] + p[-dx] + p[-dx+1] + p[-1] + p[1] + p[dx-1] + p[dx] + p[dx+1];
+        uint64_t next = next_cell<Species>(value, neighbors, tie_input(seed, cell), r, stats.ties);
+        out->arr[i] = next;
+        if (next != value) {
+            stats.changed++;
+            stats.population += value == 0;
+            stats.hash ^= zobrist(cell, value) ^ zobrist(cell, next);
+            changed->push_back(cell);
+        }
+    }
+    return stats;
+}
+
+/* Steps rows [y_begin, y_end) of grid in place. above and below are the
+ * old padded rows just outside the band, lines is room for two padded rows
+ * that roll down the band holding the old rows above and at y. */
+template <int Species, class R>
+StepStats step_rows_in_place(Grid* grid, int y_begin, int y_end, const uint64_t* above, const uint64_t* below, uint64_t* lines, uint64_t seed, Rule rule) {
+    R r = R::make(rule);
+    size_t dx = grid->width + 2;
+    uint64_t* previous = lines;
+    uint64_t* current = lines + dx;
+    std::copy(above, above + dx, previous);
+    StepStats stats = { 0, 0, 0, 0 };
+    for (int y = y_begin; y < y_end; y++) {
+        uint64_t* row = grid->arr + (y+1) * dx;
+        std::copy(row, row + dx, current);
+        const uint64_t* next = y + 1 < y_end ? row + dx : below;
+        stats = stats + step_row<Species>(previous + 1, current + 1, next + 1, row + 1, grid->width, uint64_t(y) * grid->width, seed, r);
+        std::swap(previous, current);
+    }
+    return stats;
+}
+
+typedef StepStats (*StepFunction)(const Grid* in, Grid* out, int y_begin, int y_end, uint64_t seed, Rule rule, int row_offset);
+typedef StepStats (*CellFunction)(const Grid* in, Grid* out, const uint32_t* cells, size_t count, uint64_t seed, Rule rule, std::vector<uint32_t>* changed);
+typedef StepStats (*InPlaceFunction)(Grid* grid, int y_begin, int y_end, const uint64_t* above, const uint64_t* below, uint64_t* lines, uint64_t seed, Rule rule);
+
+// Sees rows [y_begin, y_end) of the generation being stepped from
+typedef std::function<void(int y_begin, int y_end)> RowObserver;
+
+/* Picks the instantiation for (species, rule). Well known rules get fully
+ * constant masks, anything else still runs the same bit-parallel code with
+ * the masks loaded at runtime. */
+class CpuStepper {
+public:
+    CpuStepper(int species, Rule rule);
+    /* row_offset is where in's first row sits on the whole board, for the
+     * tie-break and hash indices of a board stepped in bands. Tasks get at
+     * least grain rows. */
+    StepStats step(const Grid* in, Grid* out, uint64_t seed, int row_offset = 0, int grain = 1);
+    // Single threaded, for callers that parallelise across boards themselves
+    StepStats stepRows(const Grid* in, Grid* out, int y_begin, int y_end, uint64_t seed, int row_offset = 0);
+    // Single threaded as well, see step_cells
+    StepStats stepCells(const Grid* in, Grid* out, const uint32_t* cells, size_t count, uint64_t seed, std::vector<uint32_t>* changed);
+    /* Steps grid without a second board, in parallel bands of band rows.
+     * The old first and last row of every band are saved before any band
+     * starts, so a band's neighbours still see the old rows they need.
+     * observe sees every band just before it's stepped. */
+    StepStats stepInPlace(Grid* grid, uint64_t seed, int band, const RowObserver& observe = nullptr);
+    bool specialized() const;
+private:
+    StepFunction m_step;
+    CellFunction m_cells;
+    InPlaceFunction m_inPlace;
+    std::vector<uint64_t> m_halos; // old first and last row of every band
+    Rule m_rule;
+    bool m_specialized;
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <string>
+#include "rule.h"
+#include "simulation.h"
+
+// Seconds every candidate is timed for
+const double TUNE_SECONDS = 0.3;
+// Drawn points of the region tuned frames reduce, the window's
+const int TUNE_SCREEN_WIDTH = 1024;
+const int TUNE_SCREEN_HEIGHT = 784;
+
+/* The fastest settings found for one board shape on this host */
+typedef struct {
+    SimulationSettings settings;
+    double cells_per_second;
+} TuneResult;
+
+/* Times frames of a seeded width x height board on the CPU with a range of
+ * band sizes and on every OpenCL device, fused and in separate passes at a
+ * range of local sizes. Returns the fastest, base supplies everything the
+ * tuner doesn't touch. */
+TuneResult autotune(int width, int height, int species, Rule rule, const SimulationSettings& base, double seconds = TUNE_SECONDS);
+std::string settings_string(const SimulationSettings& settings);
+
+/* One profile per host, a CSV in GOL_PROFILE_DIR or ~/.config/game-of-life
+ * named by a hash of the CPU and every OpenCL device and driver, so a new
+ * driver starts over. It keeps a row per board shape. */
+std::string profile_path();
+bool save_profile(int width, int height, int species, Rule rule, const TuneResult& result);
+// Applies the row for the board shape to settings, false when there's none
+bool load_profile(int width, int height, int species, Rule rule, SimulationSettings* settings);
+
+#endif
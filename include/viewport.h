@@ -0,0 +1,40 @@
+#ifndef VIEWPORT_H
+#define VIEWPORT_H
+
+const int MIN_LEVEL = -5;
+const int MAX_LEVEL = 15;
+
+/* Pan/zoom state. At level > 0 every drawn point covers a 2^level square of
+ * cells, at level < 0 every cell is drawn as a 2^-level square of points. */
+typedef struct {
+    int screen_width;
+    int screen_height;
+    int board_width;
+    int board_height;
+    int level;
+    int x; // cell drawn at the bottom left corner of the screen
+    int y;
+} Viewport;
+
+/* The part of the board that is visible, in terms of drawn points */
+typedef struct {
+    int x;
+    int y;
+    int cols;
+    int rows;
+    int step;       // cells per point along each axis
+    int point_size; // screen points per drawn point
+    int offset_x;   // screen point where drawing starts, centres small boards
+    int offset_y;
+} Region;
+
+Viewport viewport_init(int screen_width, int screen_height, int board_width, int board_height);
+void viewport_fit(Viewport* view);
+void viewport_zoom(Viewport* view, int levels, double screen_x, double screen_y);
+void viewport_pan(Viewport* view, double dx, double dy);
+Region viewport_region(const Viewport* view);
+/* Cell under a screen point measured from the bottom left, the middle one
+ * of a zoomed out point. False when the point is off the board. */
+bool viewport_cell(const Viewport* view, double screen_x, double screen_y, int* x, int* y);
+
+#endif
@@ -0,0 +1,233 @@
+#include "counters.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#ifdef HAVE_PERF_EVENT
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static const char* PHASE_NAMES[] = { "init", "step", "vertices", "readback" };
+
+#ifdef HAVE_PERF_EVENT
+static const uint64_t EVENTS[COUNTER_COUNT] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+/* Counts the calling thread wherever it runs, user space only so the
+ * default paranoia allows it. The leader starts disabled, members follow
+ * it, so enabling the leader's group switches all of them together. */
+static int open_event(uint64_t event, int leader) {
+	perf_event_attr attr = {};
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = event;
+	attr.disabled = leader < 0;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return int(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+}
+
+static void enable_group(int leader, bool enable) {
+	ioctl(leader, enable ? PERF_EVENT_IOC_ENABLE : PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+}
+#endif
+
+PerfCounters::PerfCounters() {
+	reset();
+	m_counting = false;
+	m_owner = std::this_thread::get_id();
+	open();
+	m_ok = m_threads[m_owner]->fds[CYCLES] >= 0;
+	if (m_ok) {
+		observe(true);
+	}
+}
+
+PerfCounters::~PerfCounters() {
+	observe(false);
+#ifdef HAVE_PERF_EVENT
+	for (auto& entry : m_threads) {
+		for (int fd : entry.second->fds) {
+			if (fd >= 0) {
+				close(fd);
+			}
+		}
+	}
+#endif
+}
+
+bool PerfCounters::ok() const {
+	return m_ok;
+}
+
+void PerfCounters::on_scheduler_entry(bool) {
+	open();
+}
+
+// Gives the calling thread its counters the first time it's seen
+void PerfCounters::open() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::unique_ptr<Thread>& thread = m_threads[std::this_thread::get_id()];
+	if (thread) {
+		return;
+	}
+	thread.reset(new Thread);
+	for (int c = 0; c < COUNTER_COUNT; c++) {
+		thread->fds[c] = -1;
+		thread->started[c] = 0;
+	}
+#ifdef HAVE_PERF_EVENT
+	thread->fds[CYCLES] = open_event(EVENTS[CYCLES], -1);
+	if (thread->fds[CYCLES] < 0) {
+		return;
+	}
+	for (int c = CYCLES + 1; c < COUNTER_COUNT; c++) {
+		thread->fds[c] = open_event(EVENTS[c], thread->fds[CYCLES]);
+	}
+	// Joined partway through a phase, counts from zero
+	if (m_counting) {
+		enable_group(thread->fds[CYCLES], true);
+	}
+#endif
+}
+
+// One read of the whole group, in the order its events were opened
+void PerfCounters::read(const Thread& thread, int64_t* counts) {
+	for (int c = 0; c < COUNTER_COUNT; c++) {
+		counts[c] = -1;
+	}
+	if (thread.fds[CYCLES] < 0) {
+		return;
+	}
+#ifdef HAVE_PERF_EVENT
+	uint64_t values[3 + COUNTER_COUNT];
+	if (::read(thread.fds[CYCLES], values, sizeof(values)) < ssize_t(3 * sizeof(uint64_t))) {
+		return;
+	}
+	// With more events than hardware counters the kernel takes turns, scale up to the whole time
+	double scale = values[2] ? double(values[1]) / values[2] : 0;
+	int slot = 0;
+	for (int c = 0; c < COUNTER_COUNT; c++) {
+		if (thread.fds[c] >= 0 && uint64_t(slot) < values[0]) {
+			counts[c] = int64_t(values[3 + slot++] * scale);
+		}
+	}
+#endif
+}
+
+void PerfCounters::begin(Phase) {
+	if (!m_ok) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for (auto& entry : m_threads) {
+		Thread& thread = *entry.second;
+		read(thread, thread.started);
+#ifdef HAVE_PERF_EVENT
+		if (thread.fds[CYCLES] >= 0) {
+			enable_group(thread.fds[CYCLES], true);
+		}
+#endif
+	}
+	m_counting = true;
+}
+
+/* Adds what every thread counted since begin(), events the owning thread
+ * lacks stay at -1 so a partial sum is never reported */
+void PerfCounters::end(Phase phase, uint64_t cells) {
+	if (!m_ok) {
+		return;
+	}
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_counting = false;
+	PhaseCounts& counts = m_phases[int(phase)];
+	const Thread* owner = m_threads[m_owner].get();
+	int64_t total[COUNTER_COUNT] = {};
+	for (auto& entry : m_threads) {
+		const Thread& thread = *entry.second;
+#ifdef HAVE_PERF_EVENT
+		if (thread.fds[CYCLES] >= 0) {
+			enable_group(thread.fds[CYCLES], false);
+		}
+#endif
+		int64_t now[COUNTER_COUNT];
+		read(thread, now);
+		for (int c = 0; c < COUNTER_COUNT; c++) {
+			if (now[c] < 0) {
+				continue;
+			}
+			int64_t delta = now[c] - thread.started[c];
+			total[c] += delta;
+			if (&thread == owner && owner->fds[c] >= 0) {
+				counts.owner[c] = std::max<int64_t>(counts.owner[c], 0) + delta;
+			}
+		}
+	}
+	for (int c = 0; c < COUNTER_COUNT; c++) {
+		if (owner->fds[c] < 0) {
+			counts.counts[c] = -1;
+			counts.owner[c] = -1;
+		} else {
+			counts.counts[c] = std::max<int64_t>(counts.counts[c], 0) + total[c];
+		}
+	}
+	counts.cells += cells;
+	counts.frames++;
+}
+
+const PhaseCounts& PerfCounters::counts(Phase phase) const {
+	return m_phases[int(phase)];
+}
+
+void PerfCounters::report() const {
+	if (!m_ok) {
+		return;
+	}
+	for (int p = 0; p < int(Phase::Count); p++) {
+		const PhaseCounts& counts = m_phases[p];
+		if (!counts.frames || !counts.cells) {
+			continue;
+		}
+		std::cout << "\t" << PHASE_NAMES[p] << "\n";
+		report_line("all threads", counts.counts, counts);
+		report_line("main thread", counts.owner, counts);
+	}
+}
+
+void PerfCounters::report_line(const char* name, const int64_t* values, const PhaseCounts& counts) {
+	char line[256];
+	int length = snprintf(line, sizeof(line), "\t\t%-12s %7.1fM cycles/frame", name,
+		double(values[CYCLES]) / counts.frames / 1e6);
+	if (values[INSTRUCTIONS] >= 0) {
+		length += snprintf(line + length, sizeof(line) - length, ", %.2f IPC",
+			values[CYCLES] ? double(values[INSTRUCTIONS]) / values[CYCLES] : 0.0);
+	}
+	if (values[CACHE_MISSES] >= 0) {
+		double misses = double(values[CACHE_MISSES]) / counts.cells;
+		length += snprintf(line + length, sizeof(line) - length, ", %.3f cache misses/cell (%.2f bytes/cell)",
+			misses, misses * CACHE_LINE_BYTES);
+	}
+	if (values[BRANCH_MISSES] >= 0) {
+		snprintf(line + length, sizeof(line) - length, ", %.3f branch misses/cell",
+			double(values[BRANCH_MISSES]) / counts.cells);
+	}
+	std::cout << line << "\n";
+}
+
+void PerfCounters::reset() {
+	for (PhaseCounts& counts : m_phases) {
+		for (int c = 0; c < COUNTER_COUNT; c++) {
+			counts.counts[c] = 0;
+			counts.owner[c] = 0;
+		}
+		counts.cells = 0;
+		counts.frames = 0;
+	}
+}
@@ -0,0 +1,91 @@
+#include "cycle.h"
+#include <algorithm>
+#include "oneapi/tbb/blocked_range.h"
+#include "oneapi/tbb/parallel_reduce.h"
+#include "stepper.h"
+
+using namespace oneapi;
+
+uint64_t board_hash(const Grid* grid) {
+	return tbb::parallel_reduce(tbb::blocked_range<int>(0, grid->height), 0ULL,
+		[grid](const tbb::blocked_range<int>& r, uint64_t hash) {
+			for (int y = r.begin(); y < r.end(); y++) {
+				const uint64_t* row = grid->arr + (y+1) * (grid->width+2) + 1;
+				uint64_t gid = uint64_t(y) * grid->width;
+				for (int x = 0; x < grid->width; x++) {
+					hash ^= zobrist(gid + x, row[x]);
+				}
+			}
+			return hash;
+		},
+		[](uint64_t a, uint64_t b) { return a ^ b; }
+	);
+}
+
+CycleDetector::CycleDetector() {
+	reset();
+}
+
+void CycleDetector::reset() {
+	m_count = 0;
+	m_candidate = 0;
+	m_streak = 0;
+	m_period = 0;
+	m_confirmedAt = 0;
+}
+
+// Hash pushed age generations before the latest one
+uint64_t CycleDetector::at(int age) const {
+	return m_hashes[(m_count - 1 - age) % CYCLE_HISTORY];
+}
+
+int CycleDetector::push(uint64_t hash, bool random) {
+	m_hashes[m_count % CYCLE_HISTORY] = hash;
+	m_random[m_count % CYCLE_HISTORY] = random;
+	m_count++;
+
+	// Shortest period that brings back the latest hash
+	int found = 0;
+	int history = std::min(m_count, CYCLE_HISTORY);
+	for (int p = 1; p < history; p++) {
+		if (at(p) == hash) {
+			found = p;
+			break;
+		}
+	}
+
+	if (found && found == m_candidate) {
+		m_streak++;
+	} else {
+		m_candidate = found;
+		m_streak = found ? 1 : 0;
+		if (m_period && found != m_period) {
+			// Left the cycle, only possible through a tie-break
+			m_period = 0;
+		}
+	}
+
+	if (m_period || m_streak < m_candidate) {
+		return m_period;
+	}
+	for (int age = 0; age < m_candidate; age++) {
+		if (m_random[(m_count - 1 - age) % CYCLE_HISTORY]) {
+			return 0;
+		}
+	}
+	m_period = m_candidate;
+	m_confirmedAt = m_count - 1;
+	return m_period;
+}
+
+int CycleDetector::period() const {
+	return m_period;
+}
+
+int CycleDetector::generation() const {
+	return m_count - 1;
+}
+
+int CycleDetector::confirmedAt() const {
+	return m_confirmedAt;
+}
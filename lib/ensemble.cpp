@@ -0,0 +1,479 @@
+#include "ensemble.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "oneapi/tbb/blocked_range.h"
+#include "oneapi/tbb/parallel_for.h"
+#include "kernels.h"
+
+using namespace oneapi;
+
+// Boards smaller than this are stepped by one thread each
+const int SEQUENTIAL_BOARD_CELLS = 1 << 16;
+
+const char* outcome_name(Outcome outcome) {
+	switch (outcome) {
+		case Outcome::Running:
+			return "running";
+		case Outcome::Limit:
+			return "limit";
+		case Outcome::Extinct:
+			return "extinct";
+		case Outcome::Stasis:
+			return "stasis";
+		case Outcome::Cycle:
+			return "cycle";
+	}
+	return "unknown";
+}
+
+bool read_board_specs(const std::string& path, std::vector<BoardSpec>* specs) {
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || !isdigit((unsigned char)line[0])) {
+			continue;
+		}
+		BoardSpec spec;
+		unsigned long long seed = 0;
+		if (sscanf(line.c_str(), "%d,%d,%d,%d,%llu", &spec.width, &spec.height, &spec.species, &spec.density, &seed) != 5) {
+			std::cout << "Skipping malformed board spec: " << line << "\n";
+			continue;
+		}
+		spec.seed = seed;
+		if (spec.width < 1 || spec.height < 1 || spec.species < 1 || spec.species > 16) {
+			std::cout << "Skipping invalid board spec: " << line << "\n";
+			continue;
+		}
+		specs->push_back(spec);
+	}
+	return true;
+}
+
+std::vector<BoardSpec> sweep_board_specs(int count, int width, int height, uint64_t seed) {
+	std::vector<BoardSpec> specs;
+	for (int i=0; i < count; i++) {
+		BoardSpec spec;
+		spec.width = width;
+		spec.height = height;
+		spec.species = 2 + i % 9;
+		spec.density = 10 + 10 * ((i / 9) % 8);
+		spec.seed = seed + i;
+		specs.push_back(spec);
+	}
+	return specs;
+}
+
+Ensemble::Ensemble(
+        const std::vector<BoardSpec>& specs,
+        Rule rule,
+        const SimulationSettings& settings
+    )
+{
+	m_specs = specs;
+	m_rule = rule;
+	m_settings = settings;
+	m_cellsPerSecond = 0;
+	m_cellsIn = nullptr;
+	m_cellsOut = nullptr;
+	m_ctx = nullptr;
+	m_program = nullptr;
+	m_queue = nullptr;
+	m_kernel = nullptr;
+	m_inBuffer = nullptr;
+	m_outBuffer = nullptr;
+	m_offsetBuffer = nullptr;
+	m_startBuffer = nullptr;
+	m_widthBuffer = nullptr;
+	m_seedBuffer = nullptr;
+	m_activeBuffer = nullptr;
+	m_changeBuffer = nullptr;
+	m_populationBuffer = nullptr;
+	m_hashBuffer = nullptr;
+	m_tieBuffer = nullptr;
+	uint64_t cells = 0;
+	for (const BoardSpec& spec : m_specs) {
+		cells += uint64_t(spec.width) * spec.height;
+	}
+	// The NDRange and every board's cell index are 32 bits
+	m_ok = cells <= MAX_ENSEMBLE_CELLS;
+	if (!m_ok) {
+		std::cerr << "Ensemble has " << cells << " cells, more than the " << MAX_ENSEMBLE_CELLS << " one launch can index\n";
+		return;
+	}
+	setupBoards();
+	if (m_settings.backend == Backend::CPU) {
+		m_steppers.assign(16, nullptr);
+		for (const BoardSpec& spec : m_specs) {
+			if (!m_steppers[spec.species - 1]) {
+				m_steppers[spec.species - 1] = new CpuStepper(spec.species, rule);
+			}
+		}
+		return;
+	}
+	setupPlatform();
+	setupKernels();
+	if (m_ok) {
+		setupBuffers();
+	}
+}
+
+Ensemble::~Ensemble() {
+	if (m_queue) {
+		clFinish(m_queue);
+	}
+	cl_mem buffers[] = { m_inBuffer, m_outBuffer, m_offsetBuffer, m_startBuffer, m_widthBuffer, m_seedBuffer,
+		m_activeBuffer, m_changeBuffer, m_populationBuffer, m_hashBuffer, m_tieBuffer };
+	for (cl_mem buffer : buffers) {
+		if (buffer) {
+			clReleaseMemObject(buffer);
+		}
+	}
+	if (m_kernel) {
+		clReleaseKernel(m_kernel);
+	}
+	if (m_queue) {
+		clReleaseCommandQueue(m_queue);
+	}
+	if (m_program) {
+		clReleaseProgram(m_program);
+	}
+	if (m_ctx) {
+		clReleaseContext(m_ctx);
+	}
+	for (CpuStepper* stepper : m_steppers) {
+		delete stepper;
+	}
+	delete[] m_cellsIn;
+	delete[] m_cellsOut;
+}
+
+bool Ensemble::ok() const {
+	return m_ok;
+}
+
+void Ensemble::setupBoards() {
+	size_t boards = m_specs.size();
+	m_paddedCells = 0;
+	uint64_t cells = 0;
+	for (const BoardSpec& spec : m_specs) {
+		m_offsets.push_back(m_paddedCells);
+		m_starts.push_back(cells);
+		m_widths.push_back(spec.width);
+		m_seeds.push_back(uint32_t(spec.seed ^ (spec.seed >> 32)));
+		m_paddedCells += size_t(spec.width + 2) * (spec.height + 2);
+		cells += uint64_t(spec.width) * spec.height;
+	}
+	m_cells = cells;
+	m_active.assign(boards, 1);
+	m_changes.assign(boards, 0);
+	m_population.assign(boards, 0);
+	m_hashes.assign(2 * boards, 0);
+	m_ties.assign(boards, 0);
+	m_detectors.assign(boards, CycleDetector());
+	m_fastForward.assign(boards, 0);
+
+	m_cellsIn = new uint64_t[m_paddedCells]();
+	m_cellsOut = new uint64_t[m_paddedCells]();
+	m_stats.resize(boards);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, boards),
+		[this](const tbb::blocked_range<size_t>& r) {
+			for (size_t b = r.begin(); b < r.end(); b++) {
+				Grid grid = view(b, m_cellsIn);
+				grid_seed(&grid, m_specs[b].density, m_specs[b].seed);
+				BoardStats& stats = m_stats[b];
+				stats.outcome = Outcome::Running;
+				stats.generations = 0;
+				stats.period = 0;
+				stats.cycle_start = 0;
+				uint64_t hash = board_hash(&grid);
+				m_hashes[2*b] = uint32_t(hash);
+				m_hashes[2*b+1] = uint32_t(hash >> 32);
+				m_detectors[b].push(hash, false);
+				stats.initial_population = get_active_points(&grid);
+				stats.population = stats.initial_population;
+				std::fill(std::begin(stats.species), std::end(stats.species), 0);
+			}
+		}
+	);
+}
+
+void Ensemble::setupPlatform() {
+	cl_int err;
+	m_device = select_device(m_settings.device);
+	m_ctx = clCreateContext(nullptr, 1, &m_device, nullptr, nullptr, &err);
+}
+
+void Ensemble::setupKernels() {
+	cl_int err;
+	m_program = build_program(m_ctx, m_device, ensemble_kernel_source(), ensemble_kernel_options(m_rule), m_settings.kernel_cache);
+	// build_program printed the build log, ok() reports the failure
+	if (!m_program) {
+		std::cerr << "Build failed, aborting\n";
+		m_ok = false;
+		return;
+	}
+	m_queue = clCreateCommandQueue(m_ctx, m_device, 0, &err);
+	m_kernel = clCreateKernel(m_program, "stepEnsemble", &err);
+
+	// The in-group reduction needs a power of two
+	size_t maxLocal = 0;
+	clGetKernelWorkGroupInfo(m_kernel, m_device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(size_t), &maxLocal, nullptr);
+	m_localSize = 1;
+	while (m_localSize * 2 <= std::min<size_t>(maxLocal, 256)) {
+		m_localSize *= 2;
+	}
+}
+
+void Ensemble::setupBuffers() {
+	cl_int err;
+	size_t boards = m_specs.size();
+	size_t cellBytes = m_paddedCells * sizeof(uint64_t);
+	m_inBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, cellBytes, m_cellsIn, &err);
+	m_outBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, cellBytes, m_cellsOut, &err);
+	m_offsetBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, boards * sizeof(cl_ulong), m_offsets.data(), &err);
+	m_startBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, boards * sizeof(cl_uint), m_starts.data(), &err);
+	m_widthBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, boards * sizeof(cl_int), m_widths.data(), &err);
+	m_seedBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, boards * sizeof(cl_uint), m_seeds.data(), &err);
+	m_activeBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, boards * sizeof(cl_uchar), m_active.data(), &err);
+	m_changeBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE, boards * sizeof(cl_uint), nullptr, &err);
+	m_populationBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE, boards * sizeof(cl_uint), nullptr, &err);
+	m_hashBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, 2 * boards * sizeof(cl_uint), m_hashes.data(), &err);
+	m_tieBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE, boards * sizeof(cl_uint), nullptr, &err);
+}
+
+Grid Ensemble::view(int board, uint64_t* cells) {
+	Grid grid;
+	grid.width = m_specs[board].width;
+	grid.height = m_specs[board].height;
+	grid.species = m_specs[board].species;
+	grid.arr = cells + m_offsets[board];
+	return grid;
+}
+
+void Ensemble::stepDevice(int generation) {
+	size_t boards = m_specs.size();
+	cl_uint zero = 0;
+	clEnqueueFillBuffer(m_queue, m_changeBuffer, &zero, sizeof(cl_uint), 0, boards * sizeof(cl_uint), 0, nullptr, nullptr);
+	clEnqueueFillBuffer(m_queue, m_populationBuffer, &zero, sizeof(cl_uint), 0, boards * sizeof(cl_uint), 0, nullptr, nullptr);
+	clEnqueueFillBuffer(m_queue, m_tieBuffer, &zero, sizeof(cl_uint), 0, boards * sizeof(cl_uint), 0, nullptr, nullptr);
+
+	cl_int boardCount = boards;
+	cl_uint cells = m_cells;
+	cl_uint gen = generation;
+	clSetKernelArg(m_kernel, 0, sizeof(cl_mem), &m_inBuffer);
+	clSetKernelArg(m_kernel, 1, sizeof(cl_mem), &m_outBuffer);
+	clSetKernelArg(m_kernel, 2, sizeof(cl_mem), &m_offsetBuffer);
+	clSetKernelArg(m_kernel, 3, sizeof(cl_mem), &m_startBuffer);
+	clSetKernelArg(m_kernel, 4, sizeof(cl_mem), &m_widthBuffer);
+	clSetKernelArg(m_kernel, 5, sizeof(cl_mem), &m_seedBuffer);
+	clSetKernelArg(m_kernel, 6, sizeof(cl_mem), &m_activeBuffer);
+	clSetKernelArg(m_kernel, 7, sizeof(cl_mem), &m_changeBuffer);
+	clSetKernelArg(m_kernel, 8, sizeof(cl_mem), &m_populationBuffer);
+	clSetKernelArg(m_kernel, 9, sizeof(cl_mem), &m_hashBuffer);
+	clSetKernelArg(m_kernel, 10, sizeof(cl_mem), &m_tieBuffer);
+	clSetKernelArg(m_kernel, 11, m_localSize * sizeof(cl_uint), nullptr);
+	clSetKernelArg(m_kernel, 12, m_localSize * sizeof(cl_ulong), nullptr);
+	clSetKernelArg(m_kernel, 13, sizeof(cl_int), &boardCount);
+	clSetKernelArg(m_kernel, 14, sizeof(cl_uint), &cells);
+	clSetKernelArg(m_kernel, 15, sizeof(cl_uint), &gen);
+
+	size_t globalWorkSize = (m_cells + m_localSize - 1) / m_localSize * m_localSize;
+	clEnqueueNDRangeKernel(m_queue, m_kernel, 1, nullptr, &globalWorkSize, &m_localSize, 0, nullptr, nullptr);
+	clEnqueueReadBuffer(m_queue, m_changeBuffer, CL_FALSE, 0, boards * sizeof(cl_uint), m_changes.data(), 0, nullptr, nullptr);
+	clEnqueueReadBuffer(m_queue, m_hashBuffer, CL_FALSE, 0, 2 * boards * sizeof(cl_uint), m_hashes.data(), 0, nullptr, nullptr);
+	clEnqueueReadBuffer(m_queue, m_tieBuffer, CL_FALSE, 0, boards * sizeof(cl_uint), m_ties.data(), 0, nullptr, nullptr);
+	clEnqueueReadBuffer(m_queue, m_populationBuffer, CL_TRUE, 0, boards * sizeof(cl_uint), m_population.data(), 0, nullptr, nullptr);
+}
+
+void Ensemble::stepHost(int generation) {
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, m_specs.size(), 1),
+		[this, generation](const tbb::blocked_range<size_t>& r) {
+			for (size_t b = r.begin(); b < r.end(); b++) {
+				if (!m_active[b]) {
+					continue;
+				}
+				Grid in = view(b, m_cellsIn);
+				Grid out = view(b, m_cellsOut);
+				CpuStepper* stepper = m_steppers[in.species - 1];
+				// Same per board tie-break seed as the kernel
+				uint64_t seed = pcg_hash(m_seeds[b] ^ uint32_t(generation));
+				StepStats stats;
+				if (in.width * in.height < SEQUENTIAL_BOARD_CELLS) {
+					stats = stepper->stepRows(&in, &out, 0, in.height, seed);
+				} else {
+					stats = stepper->step(&in, &out, seed);
+				}
+				m_changes[b] = stats.changed;
+				m_population[b] = stats.population;
+				m_ties[b] = stats.ties;
+				m_hashes[2*b] ^= uint32_t(stats.hash);
+				m_hashes[2*b+1] ^= uint32_t(stats.hash >> 32);
+			}
+		}
+	);
+}
+
+// Makes both buffers hold the final generation, so later swaps don't matter
+void Ensemble::finishBoard(int board, Outcome outcome, int generation) {
+	m_active[board] = 0;
+	m_stats[board].outcome = outcome;
+	m_stats[board].generations = generation;
+	size_t offset = m_offsets[board] * sizeof(uint64_t);
+	size_t bytes = size_t(m_specs[board].width + 2) * (m_specs[board].height + 2) * sizeof(uint64_t);
+	if (m_settings.backend == Backend::CPU) {
+		memcpy(m_cellsIn + m_offsets[board], m_cellsOut + m_offsets[board], bytes);
+	} else {
+		clEnqueueCopyBuffer(m_queue, m_outBuffer, m_inBuffer, offset, offset, bytes, 0, nullptr, nullptr);
+	}
+}
+
+// Once a period is confirmed the rest of the run would only go round it,
+// so the board steps to the phase the limit lands on and stops there
+void Ensemble::checkCycle(int board, int generation, int generation_limit) {
+	BoardStats& stats = m_stats[board];
+	if (m_fastForward[board] > 0) {
+		if (--m_fastForward[board] == 0) {
+			finishBoard(board, Outcome::Cycle, generation_limit);
+		}
+		return;
+	}
+	uint64_t hash = uint64_t(m_hashes[2*board+1]) << 32 | m_hashes[2*board];
+	int period = m_detectors[board].push(hash, m_ties[board] > 0);
+	if (!period) {
+		return;
+	}
+	stats.period = period;
+	stats.cycle_start = generation;
+	m_fastForward[board] = (generation_limit - generation) % period;
+	if (m_fastForward[board] == 0) {
+		finishBoard(board, Outcome::Cycle, generation_limit);
+	}
+}
+
+void Ensemble::run(int generation_limit) {
+	auto start = std::chrono::steady_clock::now();
+	size_t boards = m_specs.size();
+	uint64_t updates = 0;
+	int remaining = boards;
+
+	for (int generation = 0; generation < generation_limit && remaining > 0; generation++) {
+		for (size_t b = 0; b < boards; b++) {
+			if (m_active[b]) {
+				updates += uint64_t(m_specs[b].width) * m_specs[b].height;
+			}
+		}
+
+		if (m_settings.backend == Backend::CPU) {
+			stepHost(generation);
+		} else {
+			stepDevice(generation);
+		}
+
+		bool stopped = false;
+		for (size_t b = 0; b < boards; b++) {
+			if (!m_active[b]) {
+				continue;
+			}
+			m_stats[b].generations = generation + 1;
+			m_stats[b].population = m_population[b];
+			if (m_population[b] == 0) {
+				finishBoard(b, Outcome::Extinct, generation + 1);
+			} else if (m_changes[b] == 0) {
+				m_stats[b].period = 1;
+				m_stats[b].cycle_start = generation + 1;
+				finishBoard(b, Outcome::Stasis, generation + 1);
+			} else {
+				checkCycle(b, generation + 1, generation_limit);
+				if (m_active[b]) {
+					continue;
+				}
+			}
+			stopped = true;
+			remaining--;
+		}
+		if (stopped && m_settings.backend == Backend::OpenCL) {
+			clEnqueueWriteBuffer(m_queue, m_activeBuffer, CL_FALSE, 0, boards * sizeof(cl_uchar), m_active.data(), 0, nullptr, nullptr);
+		}
+
+		std::swap(m_cellsIn, m_cellsOut);
+		std::swap(m_inBuffer, m_outBuffer);
+	}
+
+	for (size_t b = 0; b < boards; b++) {
+		if (m_active[b]) {
+			m_active[b] = 0;
+			m_stats[b].outcome = Outcome::Limit;
+		}
+	}
+	if (m_settings.backend == Backend::OpenCL) {
+		clEnqueueReadBuffer(m_queue, m_inBuffer, CL_TRUE, 0, m_paddedCells * sizeof(uint64_t), m_cellsIn, 0, nullptr, nullptr);
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	m_cellsPerSecond = seconds > 0 ? updates / seconds : 0;
+	collectStats();
+}
+
+void Ensemble::collectStats() {
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, m_specs.size()),
+		[this](const tbb::blocked_range<size_t>& r) {
+			for (size_t b = r.begin(); b < r.end(); b++) {
+				Grid grid = view(b, m_cellsIn);
+				BoardStats& stats = m_stats[b];
+				std::fill(std::begin(stats.species), std::end(stats.species), 0);
+				stats.population = 0;
+				for (int y=0; y < grid.height; y++) {
+					for (int x=0; x < grid.width; x++) {
+						uint64_t value = check(&grid, x, y);
+						if (value) {
+							stats.species[__builtin_ctzll(value) / 4]++;
+							stats.population++;
+						}
+					}
+				}
+			}
+		}
+	);
+}
+
+bool Ensemble::writeCsv(const std::string& path) {
+	std::ofstream file(path);
+	if (!file) {
+		return false;
+	}
+	int columns = 0;
+	for (const BoardSpec& spec : m_specs) {
+		columns = std::max(columns, spec.species);
+	}
+
+	file << "board,width,height,species,density,seed,outcome,generations,period,cycle_start,initial_population,final_population";
+	for (int s = 1; s <= columns; s++) {
+		file << ",species_" << s;
+	}
+	file << "\n";
+	for (size_t b = 0; b < m_specs.size(); b++) {
+		const BoardSpec& spec = m_specs[b];
+		const BoardStats& stats = m_stats[b];
+		file << b << "," << spec.width << "," << spec.height << "," << spec.species << ","
+			<< spec.density << "," << spec.seed << "," << outcome_name(stats.outcome) << ","
+			<< stats.generations << "," << stats.period << "," << stats.cycle_start << ","
+			<< stats.initial_population << "," << stats.population;
+		for (int s = 0; s < columns; s++) {
+			file << "," << stats.species[s];
+		}
+		file << "\n";
+	}
+	return true;
+}
+
+double Ensemble::cellsPerSecond() const {
+	return m_cellsPerSecond;
+}
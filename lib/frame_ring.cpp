@@ -0,0 +1,193 @@
+#include "frame_ring.h"
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "level.h"
+
+const char RING_MAGIC[4] = { 'G', 'O', 'L', 'R' };
+const uint32_t RING_VERSION = 1;
+// Slots and cells start on their own cache lines
+const size_t RING_ALIGN = 64;
+// Reads give up after being lapped this many times in a row
+const int RING_RETRIES = 8;
+
+static size_t align(size_t bytes) {
+	return (bytes + RING_ALIGN - 1) / RING_ALIGN * RING_ALIGN;
+}
+
+// shm_open wants a single leading slash
+static std::string shm_name(const std::string& name) {
+	return name[0] == '/' ? name : "/" + name;
+}
+
+FrameRing* FrameRing::create(const std::string& name, const Grid* grid) {
+	size_t slot_bytes = align(sizeof(SlotHeader)) + align(size(const_cast<Grid*>(grid)) * sizeof(uint64_t));
+	size_t bytes = align(sizeof(RingHeader)) + FRAME_RING_SLOTS * slot_bytes;
+
+	std::string path = shm_name(name);
+	shm_unlink(path.c_str());
+	int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0) {
+		std::cerr << "Could not create shared memory " << path << ": " << strerror(errno) << "\n";
+		return nullptr;
+	}
+	if (ftruncate(fd, bytes) != 0) {
+		std::cerr << "Could not size shared memory " << path << ": " << strerror(errno) << "\n";
+		close(fd);
+		shm_unlink(path.c_str());
+		return nullptr;
+	}
+	void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		std::cerr << "Could not map shared memory " << path << ": " << strerror(errno) << "\n";
+		shm_unlink(path.c_str());
+		return nullptr;
+	}
+
+	// ftruncate zero fills, so every sequence starts even and every halo empty
+	RingHeader* header = (RingHeader*)memory;
+	header->version = RING_VERSION;
+	header->width = grid->width;
+	header->height = grid->height;
+	header->species = grid->species;
+	header->slots = FRAME_RING_SLOTS;
+	header->slot_bytes = slot_bytes;
+	header->latest.store(-1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(header->magic, RING_MAGIC, sizeof(RING_MAGIC));
+	return new FrameRing(path, memory, bytes, true);
+}
+
+FrameRing* FrameRing::attach(const std::string& name) {
+	std::string path = shm_name(name);
+	int fd = shm_open(path.c_str(), O_RDONLY, 0);
+	if (fd < 0) {
+		return nullptr;
+	}
+	off_t bytes = lseek(fd, 0, SEEK_END);
+	if (bytes < (off_t)sizeof(RingHeader)) {
+		close(fd);
+		return nullptr;
+	}
+	void* memory = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (memory == MAP_FAILED) {
+		return nullptr;
+	}
+	RingHeader* header = (RingHeader*)memory;
+	if (memcmp(header->magic, RING_MAGIC, sizeof(RING_MAGIC)) != 0 || header->version != RING_VERSION) {
+		std::cerr << path << " is not a game of life frame ring\n";
+		munmap(memory, bytes);
+		return nullptr;
+	}
+	return new FrameRing(path, memory, bytes, false);
+}
+
+FrameRing::FrameRing(const std::string& name, void* memory, size_t bytes, bool owner) {
+	m_name = name;
+	m_memory = memory;
+	m_bytes = bytes;
+	m_owner = owner;
+	m_header = (RingHeader*)memory;
+	m_next = 0;
+}
+
+FrameRing::~FrameRing() {
+	munmap(m_memory, m_bytes);
+	if (m_owner) {
+		shm_unlink(m_name.c_str());
+	}
+}
+
+SlotHeader* FrameRing::slot(int index) const {
+	return (SlotHeader*)((char*)m_memory + align(sizeof(RingHeader)) + index * m_header->slot_bytes);
+}
+
+Grid FrameRing::view(int index) const {
+	Grid grid;
+	grid.width = m_header->width;
+	grid.height = m_header->height;
+	grid.species = m_header->species;
+	grid.arr = (uint64_t*)((char*)slot(index) + align(sizeof(SlotHeader)));
+	return grid;
+}
+
+uint64_t* FrameRing::begin() {
+	SlotHeader* header = slot(m_next);
+	// Odd while the cells are being written
+	header->sequence.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	return view(m_next).arr;
+}
+
+void FrameRing::publish(const FrameInfo& info) {
+	SlotHeader* header = slot(m_next);
+	header->info = info;
+	header->sequence.fetch_add(1, std::memory_order_release);
+	m_header->latest.store(m_next, std::memory_order_release);
+	m_next = (m_next + 1) % m_header->slots;
+}
+
+bool FrameRing::reduce(const Region& region, uint8_t* levels, FrameInfo* info) {
+	bool reduced = false;
+	for (int attempt = 0; attempt < RING_RETRIES; attempt++) {
+		int64_t latest = m_header->latest.load(std::memory_order_acquire);
+		if (latest < 0) {
+			return false;
+		}
+		SlotHeader* header = slot(latest);
+		uint64_t sequence = header->sequence.load(std::memory_order_acquire);
+		if (sequence & 1) {
+			continue;
+		}
+		Grid grid = view(latest);
+		reduce_level(&grid, region, levels);
+		*info = header->info;
+		reduced = true;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (header->sequence.load(std::memory_order_relaxed) == sequence) {
+			return true;
+		}
+	}
+	// Still lapped, the last attempt may mix two generations but is drawable
+	return reduced;
+}
+
+bool FrameRing::read(Grid* grid, FrameInfo* info) {
+	if (grid->width != width() || grid->height != height()) {
+		return false;
+	}
+	for (int attempt = 0; attempt < RING_RETRIES; attempt++) {
+		int64_t latest = m_header->latest.load(std::memory_order_acquire);
+		if (latest < 0) {
+			return false;
+		}
+		SlotHeader* header = slot(latest);
+		uint64_t sequence = header->sequence.load(std::memory_order_acquire);
+		if (sequence & 1) {
+			continue;
+		}
+		memcpy(grid->arr, view(latest).arr, size(grid) * sizeof(uint64_t));
+		*info = header->info;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (header->sequence.load(std::memory_order_relaxed) == sequence) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int FrameRing::width() const {
+	return m_header->width;
+}
+
+int FrameRing::height() const {
+	return m_header->height;
+}
+
+int FrameRing::species() const {
+	return m_header->species;
+}
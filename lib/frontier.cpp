@@ -0,0 +1,180 @@
+#include "frontier.h"
+#include <algorithm>
+#include "oneapi/tbb/blocked_range.h"
+#include "oneapi/tbb/parallel_for.h"
+#include "oneapi/tbb/parallel_reduce.h"
+
+using namespace oneapi;
+
+// Changes handed to one task, a task claims up to nine times as many cells
+const size_t FRONTIER_GRAIN = 256;
+
+FrontierStepper::FrontierStepper(int species, Rule rule, int width, int height)
+	: m_stepper(species, rule)
+{
+	m_width = width;
+	m_height = height;
+	m_valid = false;
+	m_sparse = false;
+	m_population = 0;
+	m_stamps.reset(new std::atomic<uint32_t>[size_t(width) * height]);
+	for (size_t c = 0; c < size_t(width) * height; c++) {
+		m_stamps[c].store(0, std::memory_order_relaxed);
+	}
+	m_stamp = 0;
+}
+
+StepStats FrontierStepper::step(const Grid* in, Grid* out, uint64_t seed, const RowObserver& observe, int band) {
+	uint64_t cells = uint64_t(m_width) * m_height;
+	m_sparse = m_valid && m_changes.size() < cells / FRONTIER_DIVISOR;
+	if (m_sparse) {
+		StepStats stats = stepFrontier(in, out, seed);
+		if (observe) {
+			int bands = (m_height + band - 1) / band;
+			tbb::parallel_for(0, bands, [this, &observe, band](int b) {
+				observe(b * band, std::min((b + 1) * band, m_height));
+			});
+		}
+		return stats;
+	}
+
+	StepStats stats = observe ? stepDense(in, out, seed, observe, band) : m_stepper.step(in, out, seed, 0, band);
+	m_population = stats.population;
+	// Only worth listing the changes when the next step can use them
+	m_valid = stats.changed < cells / FRONTIER_DIVISOR;
+	if (m_valid) {
+		collect(in, out);
+	}
+	return stats;
+}
+
+StepStats FrontierStepper::stepDense(const Grid* in, Grid* out, uint64_t seed, const RowObserver& observe, int band) {
+	int bands = (m_height + band - 1) / band;
+	return tbb::parallel_reduce(tbb::blocked_range<int>(0, bands), StepStats{ 0, 0, 0, 0 },
+		[this, in, out, seed, &observe, band](const tbb::blocked_range<int>& r, StepStats stats) {
+			for (int b = r.begin(); b < r.end(); b++) {
+				int y_begin = b * band;
+				int y_end = std::min(y_begin + band, m_height);
+				stats = stats + m_stepper.stepRows(in, out, y_begin, y_end, seed);
+				observe(y_begin, y_end);
+			}
+			return stats;
+		},
+		[](StepStats a, StepStats b) {
+			return a + b;
+		}
+	);
+}
+
+StepStats FrontierStepper::stepFrontier(const Grid* in, Grid* out, uint64_t seed) {
+	if (++m_stamp == 0) {
+		for (size_t c = 0; c < size_t(m_width) * m_height; c++) {
+			m_stamps[c].store(0, std::memory_order_relaxed);
+		}
+		m_stamp = 1;
+	}
+
+	StepStats stats = tbb::parallel_reduce(tbb::blocked_range<size_t>(0, m_changes.size(), FRONTIER_GRAIN), StepStats{ 0, 0, 0, 0 },
+		[this, in, out, seed](const tbb::blocked_range<size_t>& r, StepStats stats) {
+			// Claim each neighbourhood cell once across all threads
+			std::vector<uint32_t> claimed;
+			claimed.reserve(r.size() * 9);
+			for (size_t c = r.begin(); c < r.end(); c++) {
+				int x = m_changes[c] % m_width;
+				int y = m_changes[c] / m_width;
+				for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, m_height - 1); ny++) {
+					for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, m_width - 1); nx++) {
+						uint32_t cell = uint32_t(ny) * m_width + nx;
+						// Neighbouring changes mostly share cells, a plain load skips the locked exchange
+						if (m_stamps[cell].load(std::memory_order_relaxed) != m_stamp &&
+								m_stamps[cell].exchange(m_stamp, std::memory_order_relaxed) != m_stamp) {
+							claimed.push_back(cell);
+						}
+					}
+				}
+			}
+			return stats + m_stepper.stepCells(in, out, claimed.data(), claimed.size(), seed, &m_buffers.local());
+		},
+		[](StepStats a, StepStats b) {
+			return a + b;
+		}
+	);
+
+	// Births were counted in population, everything else that changed died
+	m_population += stats.population;
+	m_population -= stats.changed - stats.population;
+	stats.population = m_population;
+	merge();
+	return stats;
+}
+
+// Lists the cells that differ between the last two generations
+void FrontierStepper::collect(const Grid* in, const Grid* out) {
+	tbb::parallel_for(tbb::blocked_range<int>(0, m_height),
+		[this, in, out](const tbb::blocked_range<int>& r) {
+			std::vector<uint32_t>& buffer = m_buffers.local();
+			for (int y = r.begin(); y < r.end(); y++) {
+				const uint64_t* before = in->arr + (y+1) * (m_width+2) + 1;
+				const uint64_t* after = out->arr + (y+1) * (m_width+2) + 1;
+				for (int x = 0; x < m_width; x++) {
+					if (before[x] != after[x]) {
+						buffer.push_back(uint32_t(y) * m_width + x);
+					}
+				}
+			}
+		}
+	);
+	merge();
+}
+
+// Concatenates the per thread buffers into the change list, every buffer
+// copies into its own slice so no locking is needed
+void FrontierStepper::merge() {
+	std::vector<std::vector<uint32_t>*> buffers;
+	size_t total = 0;
+	for (std::vector<uint32_t>& buffer : m_buffers) {
+		buffers.push_back(&buffer);
+		total += buffer.size();
+	}
+	std::vector<size_t> offsets(buffers.size());
+	size_t offset = 0;
+	for (size_t b = 0; b < buffers.size(); b++) {
+		offsets[b] = offset;
+		offset += buffers[b]->size();
+	}
+
+	m_changes.resize(total);
+	tbb::parallel_for(size_t(0), buffers.size(), [this, &buffers, &offsets](size_t b) {
+		std::copy(buffers[b]->begin(), buffers[b]->end(), m_changes.begin() + offsets[b]);
+		buffers[b]->clear();
+	});
+}
+
+void FrontierStepper::invalidate() {
+	m_valid = false;
+}
+
+void FrontierStepper::edit(int x, int y, int width, int height, int64_t population) {
+	if (!m_valid) {
+		return;
+	}
+	uint64_t cells = uint64_t(m_width) * m_height;
+	if (m_changes.size() + uint64_t(width) * height >= cells / FRONTIER_DIVISOR) {
+		m_valid = false;
+		return;
+	}
+	m_population += population;
+	for (int row = y; row < y + height; row++) {
+		for (int col = x; col < x + width; col++) {
+			m_changes.push_back(uint32_t(row) * m_width + col);
+		}
+	}
+}
+
+bool FrontierStepper::specialized() const {
+	return m_stepper.specialized();
+}
+
+bool FrontierStepper::sparse() const {
+	return m_sparse;
+}
@@ -1,4 +1,6 @@
 #include "game_of_life.h"
+#include <algorithm>
+#include <cstring>
 #include <cstdint>
 #include <vector>
 #include <random>
@@ -11,28 +13,125 @@
 #ifdef _MSC_VER
 #include <intrin.h>
 #endif
-#define CL_TARGET_OPENCL_VERSION 120
-#define CL_HPP_TARGET_OPENCL_VERSION 120
-#include <OpenCL/cl.h>
-#include <OpenCL/cl_gl.h>
-#include <OpenGL/OpenGL.h>
 
 
 GameOfLife::GameOfLife(
-        Grid* grid
+        Grid* grid,
+        Rule rule,
+        const SimulationSettings& settings,
+        int screen_width,
+        int screen_height,
+        float point_scale,
+        size_t history_bytes
     )
 {
-	setupGame(grid);
-	setupPlatform();
-	setupKernels();
+	m_screen_width = screen_width;
+	m_screen_height = screen_height;
+	m_point_scale = point_scale;
+	m_drawn_vertices = 0;
+	m_ring = nullptr;
+	m_paused = false;
+	m_counters = nullptr;
+	setupPlatform(grid, rule, settings);
 	setupBuffers();
+	m_history = nullptr;
+	if (history_bytes) {
+		m_history = new History(grid, 0, history_bytes);
+		if (!m_history->ok()) {
+			delete m_history;
+			m_history = nullptr;
+		}
+	}
+
+}
+
+GameOfLife::GameOfLife(
+        FrameRing* ring,
+        int screen_width,
+        int screen_height,
+        float point_scale
+    )
+{
+	m_screen_width = screen_width;
+	m_screen_height = screen_height;
+	m_point_scale = point_scale;
+	m_drawn_vertices = 0;
+	m_ring = ring;
+	m_simulation = nullptr;
+	m_history = nullptr;
+	m_paused = false;
+	m_counters = nullptr;
+	m_frame = FrameInfo{ 0, 0, 0 };
+	setupBuffers();
+}
+
+GameOfLife::~GameOfLife() {
+	delete m_history;
+	delete m_simulation;
+	glDeleteBuffers(1, &m_VBO);
+	glDeleteVertexArrays(1, &m_VAO);
+	delete[] m_vertices;
+	delete[] m_levels;
+}
+
+bool GameOfLife::ok() const {
+	return !m_simulation || m_simulation->ok();
+}
+
+cl_uint GameOfLife::step(const Region& region) {
+	return ParallelStep(region);
+}
+
+void GameOfLife::setPaused(bool paused) {
+	m_paused = paused;
+}
+
+bool GameOfLife::travel(int64_t generations) {
+	if (!m_history) {
+		return false;
+	}
+	m_paused = true;
+	int64_t target = std::max<int64_t>(int64_t(m_history->generation()) + generations, m_history->oldest());
+	int64_t retained = std::min<int64_t>(target, m_history->newest());
+	if (uint64_t(retained) != m_simulation->generation()) {
+		m_history->seek(retained);
+		m_simulation->load(m_history->board()->arr, retained);
+	}
+	// Past the newest generation there's nothing to replay, step it
+	for (int64_t generation = retained; generation < target; generation++) {
+		m_simulation->step();
+		m_simulation->finish();
+		m_simulation->sync();
+		m_history->push(m_simulation->grid(), m_simulation->generation());
+	}
+	return true;
+}
 
+void GameOfLife::stamp(int x, int y, const Pattern& pattern, int species, bool transparent) {
+	if (!m_simulation) {
+		return;
+	}
+	m_stamp.resize(size_t(pattern.width) * pattern.height);
+	pattern_cells(pattern, species, m_simulation->grid()->species, transparent, m_stamp.data());
+	m_simulation->edit(x - pattern.width / 2, y - pattern.height / 2, pattern.width, pattern.height, m_stamp.data());
+}
+
+void GameOfLife::clear(int x, int y, int width, int height) {
+	if (m_simulation) {
+		m_simulation->edit(x, y, width, height, nullptr);
+	}
+}
+
+const Simulation* GameOfLife::simulation() const {
+	return m_simulation;
+}
+
+const History* GameOfLife::history() const {
+	return m_history;
 }
 
-cl_uint GameOfLife::step() {
-	cl_uint mistakeCount = ParallelStep();
-	swap();
-	return mistakeCount;
+void GameOfLife::setCounters(PerfCounters* counters) {
+	m_counters = counters;
 }
 
 
@@ -61,57 +160,15 @@ const std::vector<std::array<GLubyte, 4>> COLORS = {
 	{255, 255, 255, 255},
 };
 
-void GameOfLife::setupGame(Grid* grid) {
-	m_grid = grid;
-	m_next = grid_init(grid->width, grid->height, grid->species);
-	clear(m_next);
-
-	m_rng = std::mt19937_64(std::random_device{}());
-	m_dist = std::uniform_int_distribution<uint64_t>(0ULL, ~(0ULL));
-
-	m_point_width_offset = 2.0 / float(grid->width);
-	m_point_height_offset = 2.0 / float(grid->height);
-	m_firstFrame = true;
-}
-
-void GameOfLife::setupPlatform() {
-	cl_int err;
-	cl_uint num_platforms = 0;
-	clGetPlatformIDs(0, nullptr, &num_platforms);
-	std::vector<cl_platform_id> platforms(num_platforms);
-	clGetPlatformIDs(num_platforms, platforms.data(), nullptr);
-
-	cl_platform_id platform = platforms[0]; // thanks apple
-	cl_uint num_devices = 0;
-	clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 0, nullptr, &num_devices);
-	std::vector<cl_device_id> devices(num_devices);
-	clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, num_devices, devices.data(), nullptr);
-	m_device = devices[0]; // thanks apple
-
-	CGLContextObj cglContext = CGLGetCurrentContext();
-	CGLShareGroupObj cglShareObj = CGLGetShareGroup(cglContext);
-
-	cl_context_properties props[] = {
-		CL_CONTEXT_PROPERTY_USE_CGL_SHAREGROUP_APPLE, 
-		(cl_context_properties) cglShareObj,
-		0
-	};
-	m_ctx = clCreateContext(props, 1, &m_device, nullptr, nullptr, &err);
+void GameOfLife::setupPlatform(Grid* grid, Rule rule, const SimulationSettings& settings) {
+	m_simulation = new Simulation(grid, rule, settings);
 }
 
 void GameOfLife::setupBuffers() {
-	cl_int err;
-	size_t gridBytes = size(m_grid) * sizeof(uint64_t);
-	m_inBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
-				gridBytes, m_grid->arr, &err);
-	m_outBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
-				gridBytes, m_next->arr, &err);
-
-	m_mistakeCount = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE, sizeof(uint), nullptr, &err);
-	m_totalVertices = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE, sizeof(uint), nullptr, &err);
-
-	m_num_vertices = m_grid->height * m_grid->width;
+	// One vertex per drawn point, so this scales with the window and not the board
+	m_num_vertices = m_screen_width * m_screen_height;
 	m_vertices = new Vertex[m_num_vertices];
+	m_levels = new cl_uchar[m_num_vertices * 2];
 
 	glGenVertexArrays(1, &m_VAO);
 	glGenBuffers(1, &m_VBO);
@@ -125,219 +182,60 @@ void GameOfLife::setupBuffers() {
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(Vertex, color));
 	glEnableVertexAttribArray(1);
-
-	m_vertexBuffer = clCreateFromGLBuffer(m_ctx, CL_MEM_READ_WRITE, m_VBO, &err);
-}
-
-void GameOfLife::setupKernels() {
-	cl_int err;
-
-	const char* kernelSrc = R"CLC(
-		__constant ulong TWO_NEIGHBOR_MASK   = 0x2222222222222222UL;
-		__constant ulong THREE_NEIGHBOR_MASK = 0x3333333333333333UL;
-		__constant ulong SPECIES_VALUE_MASK  = 0x1111111111111111UL;
-		__constant ulong LAST_BIT_MASK       = 0x8888888888888888UL;
-		__constant ulong THIRD_BIT_MASK      = 0x4444444444444444UL;
-		__constant ulong SECOND_BIT_MASK     = 0x2222222222222222UL;
-
-		__constant ulong MAGIC		     = 0x2545F4914F6CDD1DUL;
-
-		// https://www.reedbeta.com/blog/hash-functions-for-gpu-rendering/
-		uint pcg_hash(uint input) {
-			uint state = input * 747796405u + 2891336453u;
-			uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
-			return (word >> 22u) ^ word;
-		}
-
-		kernel void gameOfLife(
-			global ulong* in, 
-			global ulong* out, 
-			ulong seed, 
-			int height, 
-			int width, 
-			int species
-		) {
-			int gid = get_global_id(0);
-			int x = gid % width;
-			int y = gid / width;
-			int i = (y+1) * (width+2) + (x+1);
-			ulong value = in[i];
-			ulong neighbors = 0ul;
-			int dx = width+2;
-			neighbors += in[i-dx-1];
-			neighbors += in[i-dx];
-			neighbors += in[i-dx+1];
-			neighbors += in[i-1];
-			neighbors += in[i+1];
-			neighbors += in[i+dx-1];
-			neighbors += in[i+dx];
-			neighbors += in[i+dx+1];
-			if (!neighbors) {
-				out[i] = 0ul;
-				return;
-			}
-
-			// Live cell
-			if (value) {
-				ulong value_mask = value | value << 1 | value << 2 | value << 3;
-				neighbors &= value_mask;
-				bool two_neighbors = neighbors == (TWO_NEIGHBOR_MASK & value_mask);
-				bool three_neighbors = neighbors == (THREE_NEIGHBOR_MASK & value_mask);
-				if (two_neighbors || three_neighbors){
-					out[i] = value;
-				} else {
-					out[i] = 0UL;
-				}
-				return;
-			}
-
-			// Dead cell
-			if (neighbors & LAST_BIT_MASK) {
-				out[i] = 0UL;
-				return;
-			}
-
-			ulong m = neighbors & THIRD_BIT_MASK;
-			m = m | m >> 1 | m >> 2;
-			ulong n = neighbors & ~m;
-			n = n & (n >> 1);
-			if (!n) {
-				out[i] = 0UL;
-				return;
-			} 
-
-			ulong leading = 1ULL << (63-clz(n));
-			ulong trailing = n & (~leading);
-			if (trailing == 0) {
-				out[i] = leading;
-				return;
-			}
-			ulong rng_x = seed ^ gid;
-			ulong rng = pcg_hash(rng_x);
-			ulong random_num = rng & 1UL;
-			if (random_num == 1) {
-				out[i] = leading;
-			} else {
-				out[i] = trailing;
-			}
-		}
-
-		struct Vertex {
-			float2 position;
-			uchar4 color;
-		};
-
-		kernel void checkVertices(
-			global ulong* grid,
-			global struct Vertex* vertices,
-			volatile global uint* mistakes,
-			volatile global uint* totalVertices,
-			int width
-		) {
-			int gid = get_global_id(0);
-			int x = gid % width;
-			int y = gid / width;
-			int grid_index = (y+1) * (width+2) + (x+1);
-			int vertices_index = y * width + x;
-			ulong value = grid[grid_index];
-			struct Vertex vertex = vertices[vertices_index];
-			if (value) {
-				atomic_inc(totalVertices);
-			}
-
-			if (vertex.color[3] == 0 && value != 0) {
-				atomic_inc(mistakes);
-			}
-			if (vertex.color[3] != 0 && value == 0) {
-				atomic_inc(mistakes);
-			}
-		}
-
-	)CLC";
-
-
-	size_t srcLen = std::strlen(kernelSrc);
-	m_program = clCreateProgramWithSource(m_ctx, 1, &kernelSrc, &srcLen, &err);
-	err = clBuildProgram(m_program, 1, &m_device, "", nullptr, nullptr);
-	if (err != CL_SUCCESS) {
-		size_t logSize = 0;
-		clGetProgramBuildInfo(m_program, m_device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &logSize);
-		std::vector<char> log(logSize);
-		clGetProgramBuildInfo(m_program, m_device, CL_PROGRAM_BUILD_LOG, logSize, log.data(), nullptr);
-		std::cerr << "Build Log:\n" << log.data() << "\n";
-		std::cerr << "Build failed, aborting\n";
-		clReleaseProgram(m_program);
-		clReleaseContext(m_ctx);
-		return;
-	}
-
-	m_queue = clCreateCommandQueue(m_ctx, m_device, 0, &err);
-
-
-
-
-	m_gameKernel = clCreateKernel(m_program, "gameOfLife", &err);
-	m_debugKernel = clCreateKernel(m_program, "checkVertices", &err);
-
 }
 
-
 using namespace oneapi;
 
 
-cl_uint GameOfLife::ParallelStep()
+cl_uint GameOfLife::ParallelStep(const Region& region)
 {
-	size_t globalWorkSize = m_grid->width * m_grid->height;
-	size_t gridBytes = size(m_grid) * sizeof(uint64_t);
-	uint64_t seed = m_dist(m_rng);
-	cl_uint zero = 0;
-
-	if (!m_firstFrame) {
-		clEnqueueWriteBuffer(m_queue, m_mistakeCount, CL_TRUE, 0, sizeof(cl_uint), &zero, 0, NULL, NULL);
-		clEnqueueWriteBuffer(m_queue, m_totalVertices, CL_TRUE, 0, sizeof(cl_uint), &zero, 0, NULL, NULL);
-
-		clSetKernelArg(m_debugKernel, 0, sizeof(cl_mem), &m_outBuffer);
-		clSetKernelArg(m_debugKernel, 1, sizeof(cl_mem), &m_vertexBuffer);
-		clSetKernelArg(m_debugKernel, 2, sizeof(cl_mem), &m_mistakeCount);
-		clSetKernelArg(m_debugKernel, 3, sizeof(cl_mem), &m_totalVertices);
-		clSetKernelArg(m_debugKernel, 4, sizeof(int), &m_grid->width);
-
-		clEnqueueNDRangeKernel(m_queue, m_debugKernel, 1, nullptr, &globalWorkSize, nullptr, 0, nullptr, nullptr);
+	cl_uint vertexCount;
+	// Stepping and readback go over the board, the vertex loop over the points drawn
+	uint64_t drawn = uint64_t(region.cols) * region.rows;
+	uint64_t cells = m_simulation ? uint64_t(m_simulation->grid()->width) * m_simulation->grid()->height : drawn;
+	if (m_counters) {
+		m_counters->begin(Phase::Step);
+	}
+	if (m_ring) {
+		// Nothing published yet, draw an empty board
+		if (!m_ring->reduce(region, m_levels, &m_frame)) {
+			memset(m_levels, 0, region.cols * region.rows * 2);
+		}
+		vertexCount = m_frame.population;
+	} else if (m_paused) {
+		m_simulation->applyEdits();
+		vertexCount = m_simulation->count();
+		m_simulation->reduce(region, m_levels);
+	} else {
+		// Levels and counts come out of the same pass as the step
+		vertexCount = m_simulation->frame(region, m_levels);
+	}
+	if (m_counters) {
+		m_counters->end(Phase::Step, cells);
+		m_counters->begin(Phase::Vertices);
 	}
 
-
-	clSetKernelArg(m_gameKernel, 0, sizeof(cl_mem), &m_inBuffer);
-	clSetKernelArg(m_gameKernel, 1, sizeof(cl_mem), &m_outBuffer);
-	clSetKernelArg(m_gameKernel, 2, sizeof(uint64_t), &seed);
-	clSetKernelArg(m_gameKernel, 3, sizeof(int), &m_grid->height);
-	clSetKernelArg(m_gameKernel, 4, sizeof(int), &m_grid->width);
-	clSetKernelArg(m_gameKernel, 5, sizeof(int), &m_grid->species);
-
-	clEnqueueNDRangeKernel(m_queue, m_gameKernel, 1, nullptr, &globalWorkSize, nullptr, 0, nullptr, nullptr);
-
-
-	tbb::parallel_for(tbb::blocked_range2d<int, int>(0, m_grid->height, 0, m_grid->width), 
-		[this](const tbb::blocked_range2d<int, int>& r) {
-			Grid* grid = m_grid;
-			Grid* next = m_next;
-			float x_midpoint = (float)(grid->width+1) / 2.0;
-			float y_midpoint = (float)(grid->height+1) / 2.0;
-			int width = grid->width;
-			int height = grid->height;
-			float x_midpoint_reciprocal = 1.0 / x_midpoint;
-			float y_midpoint_reciprocal = 1.0 / y_midpoint;
-			for (int x = r.cols().begin(); x < r.cols().end(); x++) {
-				for (int y = r.rows().begin(); y < r.rows().end(); y++) {
-					uint64_t value = check(grid, x, y);
+	tbb::parallel_for(tbb::blocked_range2d<int, int>(0, region.rows, 0, region.cols), 
+		[this, &region](const tbb::blocked_range2d<int, int>& r) {
+			float point_width = 2.0 / float(m_screen_width) * region.point_size;
+			float point_height = 2.0 / float(m_screen_height) * region.point_size;
+			float x_origin = 2.0 / float(m_screen_width) * region.offset_x - 1.0 + point_width / 2;
+			float y_origin = 2.0 / float(m_screen_height) * region.offset_y - 1.0 + point_height / 2;
+			for (int row = r.rows().begin(); row < r.rows().end(); row++) {
+				for (int col = r.cols().begin(); col < r.cols().end(); col++) {
+					int vertex_index = row * region.cols + col;
+					int species_index = m_levels[vertex_index * 2];
+					int density = m_levels[vertex_index * 2 + 1];
 					Vertex vertex;
-					int vertex_index = y * width + x;
-					if (value) {
-						vertex.position[0] = float(x - x_midpoint) * x_midpoint_reciprocal + m_point_width_offset;
-						vertex.position[1] = float(y - y_midpoint) * y_midpoint_reciprocal + m_point_height_offset;
-						int species_index = __builtin_ctzll(value) / 4+1;
-						for (int i=0; i < 4; i++) {
-							vertex.color[i] = COLORS[species_index][i];
+					if (species_index) {
+						vertex.position[0] = x_origin + col * point_width;
+						vertex.position[1] = y_origin + row * point_height;
+						// Sparse blocks are drawn darker when zoomed out
+						int shade = 64 + density * 191 / 255;
+						for (int i=0; i < 3; i++) {
+							vertex.color[i] = COLORS[species_index][i] * shade / 255;
 						}
+						vertex.color[3] = COLORS[species_index][3];
 
 					} else {
 						vertex.position[0] = 0;
@@ -352,40 +250,33 @@ cl_uint GameOfLife::ParallelStep()
 			}
 		}
 	   );
-
-
-	clFinish(m_queue);
-
-	cl_uint vertexCount;
-	if (!m_firstFrame) {
-		cl_uint mistakeCount;
-		clEnqueueReadBuffer(m_queue, m_mistakeCount, CL_TRUE, 0, sizeof(cl_uint), &mistakeCount, 0, nullptr, nullptr);
-
-		if (mistakeCount != 0) {
-			std::cout << "Frame had " << mistakeCount << " mistakes!\n\n" << std::flush;
-		}
-
-		clEnqueueReadBuffer(m_queue, m_totalVertices, CL_TRUE, 0, sizeof(cl_uint), &vertexCount, 0, nullptr, nullptr);
-	} else {
-		m_firstFrame = false;
-		vertexCount = 0;
+	if (m_counters) {
+		m_counters->end(Phase::Vertices, drawn);
+		m_counters->begin(Phase::Readback);
 	}
 
-	clEnqueueReadBuffer(m_queue, m_outBuffer, CL_TRUE, 0, gridBytes, m_next->arr, 0, nullptr, nullptr);
+	if (m_simulation) {
+		m_simulation->finish();
+	}
+	if (m_history && !m_paused) {
+		// Only the tiles that changed come back from a device
+		m_simulation->sync();
+		m_history->push(m_simulation->grid(), m_simulation->generation());
+	}
+	if (m_counters) {
+		m_counters->end(Phase::Readback, cells);
+	}
+	m_drawn_vertices = region.cols * region.rows;
 
+	glPointSize(region.point_size * m_point_scale);
 	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-	glBufferData(GL_ARRAY_BUFFER, m_num_vertices * sizeof(Vertex), &m_vertices[0], GL_DYNAMIC_DRAW);
-	glDrawArrays(GL_POINTS, 0, m_grid->height * m_grid->width);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, m_drawn_vertices * sizeof(Vertex), &m_vertices[0]);
+	glDrawArrays(GL_POINTS, 0, m_drawn_vertices);
 
 
 	return vertexCount;
 }
 
-void GameOfLife::swap() {
-	std::swap(m_grid, m_next);
-	std::swap(m_inBuffer, m_outBuffer);
-}
-
 
 
 
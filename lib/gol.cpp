@@ -0,0 +1,213 @@
+#include "gol.h"
+#include <new>
+#include <string>
+#include <vector>
+#include "out_of_core.h"
+#include "pattern.h"
+#include "simulation.h"
+
+struct gol_board {
+    Simulation* simulation;
+    Rule rule;
+    uint64_t seed;
+};
+
+static thread_local std::string last_error;
+
+static int fail(const std::string& error) {
+	last_error = error;
+	return -1;
+}
+
+// Takes the grid, which is freed again if no board comes of it
+static gol_board* make_board(Grid* grid, Rule rule, gol_backend backend, uint64_t seed) {
+	SimulationSettings settings = DEFAULT_SETTINGS;
+	settings.backend = backend == GOL_BACKEND_CPU ? Backend::CPU : Backend::OpenCL;
+	settings.seed = seed;
+	Simulation* simulation;
+	try {
+		simulation = new Simulation(grid, rule, settings);
+	} catch (const std::bad_alloc&) {
+		grid_free(grid);
+		throw;
+	}
+	if (!simulation->ok()) {
+		delete simulation;
+		fail("could not build the OpenCL kernels");
+		return nullptr;
+	}
+	try {
+		return new gol_board{ simulation, rule, seed };
+	} catch (const std::bad_alloc&) {
+		delete simulation;
+		throw;
+	}
+}
+
+int gol_api_version(void) {
+	return GOL_API_VERSION;
+}
+
+const char* gol_last_error(void) {
+	return last_error.c_str();
+}
+
+gol_board* gol_create(int width, int height, int species, const char* rule, gol_backend backend, uint64_t seed) {
+	if (width <= 0 || height <= 0 || width > MAX_BOARD_SIZE || height > MAX_BOARD_SIZE) {
+		fail("invalid board size");
+		return nullptr;
+	}
+	// One nibble per species in a cell
+	if (species < 1 || species > 16) {
+		fail("species must be between 1 and 16");
+		return nullptr;
+	}
+	Rule parsed = CONWAY;
+	if (rule && !parse_rule(rule, &parsed)) {
+		fail(std::string("invalid rule ") + rule);
+		return nullptr;
+	}
+	try {
+		Grid* grid = grid_init(width, height, species);
+		grid_seed(grid, default_density(species), seed);
+		return make_board(grid, parsed, backend, seed);
+	} catch (const std::bad_alloc&) {
+		fail("not enough memory for the board");
+		return nullptr;
+	}
+}
+
+gol_board* gol_load(const char* path, gol_backend backend) {
+	gol_board* board = nullptr;
+	try {
+		BoardFileHeader header;
+		Grid* grid = load_board(path, &header);
+		if (!grid) {
+			fail(std::string("could not load ") + path);
+			return nullptr;
+		}
+		board = make_board(grid, Rule{ header.birth, header.survive }, backend, header.seed);
+		if (board) {
+			board->simulation->load(grid->arr, header.generation);
+		}
+		return board;
+	} catch (const std::bad_alloc&) {
+		gol_destroy(board);
+		fail("not enough memory for the board");
+		return nullptr;
+	}
+}
+
+void gol_destroy(gol_board* board) {
+	if (!board) {
+		return;
+	}
+	delete board->simulation;
+	delete board;
+}
+
+int gol_seed(gol_board* board, int density, uint64_t seed) {
+	if (density < 0 || density > 100) {
+		return fail("density must be a percentage");
+	}
+	Grid* grid = board->simulation->grid();
+	std::vector<uint64_t> cells(size(grid));
+	Grid seeded = { grid->height, grid->width, grid->species, cells.data() };
+	grid_seed(&seeded, density ? density : default_density(grid->species), seed);
+	// board->seed stays the tie-break seed the simulation steps with, gol_load hands it back
+	board->simulation->load(cells.data(), 0);
+	return 0;
+}
+
+int gol_step(gol_board* board, int generations) {
+	if (generations < 0) {
+		return fail("negative generation count");
+	}
+	for (int i = 0; i < generations; i++) {
+		board->simulation->step();
+	}
+	board->simulation->finish();
+	return 0;
+}
+
+int gol_stats_get(gol_board* board, gol_stats* stats) {
+	Simulation* simulation = board->simulation;
+	simulation->applyEdits();
+	simulation->finish();
+	stats->generation = simulation->generation();
+	stats->population = simulation->count();
+	stats->hash = simulation->hash();
+	stats->period = simulation->cycles().period();
+	return 0;
+}
+
+int gol_save(gol_board* board, const char* path) {
+	Simulation* simulation = board->simulation;
+	Grid* grid = simulation->grid();
+	gol_stats stats;
+	gol_stats_get(board, &stats);
+	simulation->sync();
+
+	BoardFileHeader header = {};
+	header.width = grid->width;
+	header.height = grid->height;
+	header.species = grid->species;
+	header.birth = board->rule.birth;
+	header.survive = board->rule.survive;
+	header.seed = board->seed;
+	header.generation = stats.generation;
+	header.population = stats.population;
+	header.hash = stats.hash;
+	if (!save_board(path, header, grid)) {
+		return fail(std::string("could not save ") + path);
+	}
+	return 0;
+}
+
+int gol_edit(gol_board* board, int x, int y, int width, int height, const uint64_t* cells) {
+	if (width < 0 || height < 0) {
+		return fail("negative edit size");
+	}
+	board->simulation->edit(x, y, width, height, cells);
+	return 0;
+}
+
+int gol_stamp(gol_board* board, int x, int y, const char* rle, int species) {
+	Pattern pattern;
+	if (!parse_rle(rle, &pattern)) {
+		return fail("invalid RLE pattern");
+	}
+	if (species < 1 || species > gol_species(board)) {
+		return fail("no such species on the board");
+	}
+	std::vector<uint64_t> cells(size_t(pattern.width) * pattern.height);
+	pattern_cells(pattern, species, gol_species(board), false, cells.data());
+	board->simulation->edit(x, y, pattern.width, pattern.height, cells.data());
+	return 0;
+}
+
+const uint64_t* gol_cells(gol_board* board, size_t* stride) {
+	Simulation* simulation = board->simulation;
+	simulation->applyEdits();
+	simulation->finish();
+	simulation->sync();
+	Grid* grid = simulation->grid();
+	*stride = size_t(grid->width) + 2;
+	return grid->arr + *stride + 1;
+}
+
+int gol_width(const gol_board* board) {
+	return board->simulation->grid()->width;
+}
+
+int gol_height(const gol_board* board) {
+	return board->simulation->grid()->height;
+}
+
+int gol_species(const gol_board* board) {
+	return board->simulation->grid()->species;
+}
+
+gol_backend gol_get_backend(const gol_board* board) {
+	return board->simulation->backend() == Backend::CPU ? GOL_BACKEND_CPU : GOL_BACKEND_OPENCL;
+}
@@ -1,11 +1,12 @@
 #include "grid.h"
+#include <cstring>
 #include <vector>
 #include <random>
 #include "config.h"
 #include <iostream>
 
 void clear(Grid* grid) {
-	memset(grid->arr, 0, (grid->height+2)*(grid->width+2)*sizeof(uint64_t));
+	memset(grid->arr, 0, size(grid) * sizeof(uint64_t));
 }
 void set(Grid* grid, int x, int y, uint64_t value) {
 	int i = (y+1) * (grid->width+2) + (x+1);
@@ -49,42 +50,55 @@ int get_active_points(Grid* grid){
 	return points;
 }
 
+int default_density(int species) {
+	int threshold = (10 - species) * 10;
+	if (threshold < 0) {
+		threshold = 0;
+	}
+	return 100 - threshold;
+}
+
 Grid* grid_init(int width, int height, int species) {
 	Grid* grid = new Grid;
 	grid->width = width;
 	grid->height = height;
 	grid->species = species;
-	grid->arr = new uint64_t[(width+2) * (height+2)]();
+	grid->arr = new uint64_t[size(grid)]();
+	return grid;
+}
 
-	int threshold = (10 - species) * 10;
-	if (threshold < 0) {
-		threshold = 0;
-	}
+void grid_free(Grid* grid) {
+	delete[] grid->arr;
+	delete grid;
+}
+
+void grid_seed(Grid* grid, int density, uint64_t seed) {
+	clear(grid);
 
 	// https://stackoverflow.com/questions/13445688/how-to-generate-a-random-number-in-c
-	std::random_device dev;
-	std::mt19937 rng(dev());
-	std::uniform_int_distribution<std::mt19937::result_type> distribution(1,100);
-	std::uniform_int_distribution<std::mt19937::result_type> color_distribution(1, species);
+	std::mt19937_64 rng(seed);
+	for (int y=0; y < grid->height; y++) {
+		seed_row(grid->arr + (y+1) * (grid->width+2) + 1, grid->width, grid->species, density, &rng);
+	}
+}
+
+void seed_row(uint64_t* row, int width, int species, int density, std::mt19937_64* rng) {
+	std::uniform_int_distribution<int> distribution(1,100);
+	std::uniform_int_distribution<int> color_distribution(1, species);
 
 	for (int x=0; x < width; x++) {
-		for (int y=0; y < height; y++) {
-			bool should_enable = distribution(rng) > threshold;
-			if (should_enable) {
-				int color = color_distribution(rng);
-				uint64_t value = 1ULL << ((color-1) * 4);
-				if (value == 0) {
-					std::cout << "Failed to initiate\n";
-				}
-				set(grid, x, y, value);
-			}
+		bool should_enable = distribution(*rng) <= density;
+		if (should_enable) {
+			int color = color_distribution(*rng);
+			row[x] = 1ULL << ((color-1) * 4);
+		} else {
+			row[x] = 0;
 		}
 	}
-	return grid;
 }
 
 size_t size(Grid* grid) {
-	return (grid->height + 2) * (grid->width + 2);
+	return size_t(grid->height + 2) * (grid->width + 2);
 }
 
 
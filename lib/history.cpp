@@ -0,0 +1,299 @@
+#include "history.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include "oneapi/tbb/blocked_range.h"
+#include "oneapi/tbb/parallel_for.h"
+
+using namespace oneapi;
+
+// Rows per band of the parallel diff against the last generation
+const int HISTORY_BAND = 64;
+
+static size_t align8(size_t bytes) {
+	return (bytes + 7) & ~size_t(7);
+}
+
+// Padded cell indices, then the values to XOR into them
+static size_t delta_bytes(uint32_t cells) {
+	return align8(size_t(cells) * sizeof(uint32_t)) + size_t(cells) * sizeof(uint64_t);
+}
+
+History::History(const Grid* grid, uint64_t generation, size_t bytes, int interval) {
+	m_board = grid_init(grid->width, grid->height, grid->species);
+	m_generation = generation;
+	m_interval = std::max(interval, 1);
+	m_capacity = bytes / 8 * 8;
+	m_tail = 0;
+	m_first = 0;
+	m_count = 0;
+
+	// A keyframe, a delta of every cell and the keyframe after it, with room to spare
+	size_t boardBytes = size(m_board) * sizeof(uint64_t);
+	m_ok = m_capacity >= 4 * boardBytes;
+	if (m_ok) {
+		m_arena.reset(new (std::nothrow) unsigned char[m_capacity]);
+		m_ok = m_arena != nullptr;
+	}
+	if (!m_ok) {
+		std::cout << "A " << (bytes >> 20) << "MB history can't hold a " << grid->width << "x" << grid->height
+			<< " board, rewinding is off\n";
+		return;
+	}
+	m_entries.resize(HISTORY_MAX_GENERATIONS + HISTORY_MAX_GENERATIONS / m_interval + 1);
+	m_bandCells.resize((grid->height + HISTORY_BAND - 1) / HISTORY_BAND);
+	reset(grid, generation);
+}
+
+History::~History() {
+	grid_free(m_board);
+}
+
+bool History::ok() const {
+	return m_ok;
+}
+
+History::Entry& History::entry(size_t index) {
+	return m_entries[(m_first + index) % m_entries.size()];
+}
+
+const History::Entry& History::entry(size_t index) const {
+	return m_entries[(m_first + index) % m_entries.size()];
+}
+
+/* Index of the generation's delta or keyframe, m_count when it has none.
+ * Records run in generation order with a keyframe after its delta. */
+size_t History::find(uint64_t generation, bool keyframe) const {
+	size_t low = 0;
+	size_t high = m_count;
+	while (low < high) {
+		size_t middle = (low + high) / 2;
+		const Entry& record = entry(middle);
+		if (record.generation < generation || (record.generation == generation && record.keyframe < keyframe)) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+	if (low < m_count && entry(low).generation == generation && entry(low).keyframe == keyframe) {
+		return low;
+	}
+	return m_count;
+}
+
+/* Arena offset for a record of bytes, evicting until it fits. Records go
+ * after the newest one, or back at the start when the end is too short. */
+size_t History::allocate(size_t bytes) {
+	while (m_count == m_entries.size()) {
+		evict();
+	}
+	while (true) {
+		if (m_count == 0) {
+			m_tail = 0;
+			return 0;
+		}
+		size_t head = entry(0).offset;
+		if (head < m_tail) {
+			// Retained records run from head to tail, free space either side
+			if (m_tail + bytes <= m_capacity) {
+				return m_tail;
+			}
+			if (bytes <= head) {
+				return 0;
+			}
+		} else if (m_tail + bytes <= head) {
+			// Wrapped, the only free space is between tail and head
+			return m_tail;
+		}
+		evict();
+	}
+}
+
+void History::append(const Entry& record) {
+	m_entries[(m_first + m_count) % m_entries.size()] = record;
+	m_count++;
+	m_tail = record.offset + record.bytes;
+}
+
+// Drops the oldest keyframe and the deltas after it, they need it to mean anything
+void History::evict() {
+	do {
+		m_first = (m_first + 1) % m_entries.size();
+		m_count--;
+	} while (m_count > 0 && !entry(0).keyframe);
+}
+
+// Drops the generations after generation, a step from there replaces them
+void History::truncate(uint64_t generation) {
+	while (m_count > 0 && entry(m_count - 1).generation > generation) {
+		m_count--;
+	}
+	m_tail = m_count ? entry(m_count - 1).offset + entry(m_count - 1).bytes : 0;
+}
+
+void History::reset(const Grid* grid, uint64_t generation) {
+	m_first = 0;
+	m_count = 0;
+	m_tail = 0;
+	memcpy(m_board->arr, grid->arr, size(m_board) * sizeof(uint64_t));
+	m_generation = generation;
+	keyframe();
+}
+
+void History::keyframe() {
+	size_t bytes = size(m_board) * sizeof(uint64_t);
+	Entry record = { m_generation, allocate(bytes), bytes, 0, true };
+	memcpy(m_arena.get() + record.offset, m_board->arr, bytes);
+	append(record);
+}
+
+void History::push(const Grid* grid, uint64_t generation) {
+	if (!m_ok) {
+		return;
+	}
+	if (generation != m_generation + 1 || m_count == 0) {
+		reset(grid, generation);
+		return;
+	}
+	truncate(m_generation);
+
+	// Changed cells per band first, so the delta can be written straight into the arena
+	int width = grid->width;
+	int height = grid->height;
+	size_t row = size_t(width) + 2;
+	const uint64_t* now = grid->arr;
+	uint64_t* before = m_board->arr;
+	int bands = int(m_bandCells.size());
+	tbb::parallel_for(0, bands, [this, now, before, width, height, row](int band) {
+		uint32_t cells = 0;
+		int y_end = std::min(height, (band + 1) * HISTORY_BAND);
+		for (int y = band * HISTORY_BAND; y < y_end; y++) {
+			size_t start = (y+1) * row + 1;
+			for (int x = 0; x < width; x++) {
+				cells += now[start + x] != before[start + x];
+			}
+		}
+		m_bandCells[band] = cells;
+	});
+	uint32_t cells = 0;
+	for (int band = 0; band < bands; band++) {
+		uint32_t count = m_bandCells[band];
+		m_bandCells[band] = cells;
+		cells += count;
+	}
+
+	Entry delta = { generation, 0, delta_bytes(cells), cells, false };
+	delta.offset = allocate(delta.bytes);
+	uint32_t* indices = (uint32_t*)(m_arena.get() + delta.offset);
+	uint64_t* values = (uint64_t*)(m_arena.get() + delta.offset + align8(size_t(cells) * sizeof(uint32_t)));
+	if (cells) {
+		tbb::parallel_for(0, bands, [this, now, before, width, height, row, indices, values](int band) {
+			uint32_t next = m_bandCells[band];
+			int y_end = std::min(height, (band + 1) * HISTORY_BAND);
+			for (int y = band * HISTORY_BAND; y < y_end; y++) {
+				size_t start = (y+1) * row + 1;
+				for (int x = 0; x < width; x++) {
+					uint64_t change = now[start + x] ^ before[start + x];
+					if (change) {
+						indices[next] = uint32_t(start + x);
+						values[next] = change;
+						before[start + x] = now[start + x];
+						next++;
+					}
+				}
+			}
+		});
+	}
+	append(delta);
+	m_generation = generation;
+
+	// The delta is alone when making room for it evicted everything
+	bool orphaned = !entry(0).keyframe;
+	if (generation % m_interval == 0 || orphaned) {
+		keyframe();
+	}
+	if (!entry(0).keyframe) {
+		evict();
+	}
+}
+
+// XOR is its own inverse, the same delta steps the board either way
+void History::apply(const Entry& delta) {
+	const uint32_t* indices = (const uint32_t*)(m_arena.get() + delta.offset);
+	const uint64_t* values = (const uint64_t*)(m_arena.get() + delta.offset + align8(size_t(delta.cells) * sizeof(uint32_t)));
+	uint64_t* cells = m_board->arr;
+	tbb::parallel_for(tbb::blocked_range<uint32_t>(0, delta.cells, 4096),
+		[indices, values, cells](const tbb::blocked_range<uint32_t>& r) {
+			for (uint32_t i = r.begin(); i < r.end(); i++) {
+				cells[indices[i]] ^= values[i];
+			}
+		}
+	);
+}
+
+bool History::seek(uint64_t generation) {
+	if (!m_ok || m_count == 0 || generation < oldest() || generation > newest()) {
+		return false;
+	}
+	// Keyframes either side, the oldest record is always one so there's one before
+	size_t before = find(generation, false);
+	if (before == m_count) {
+		before = find(generation, true);
+	}
+	while (!entry(before).keyframe || entry(before).generation > generation) {
+		before--;
+	}
+	size_t after = before + 1;
+	while (after < m_count && !entry(after).keyframe) {
+		after++;
+	}
+
+	uint64_t distance = generation > m_generation ? generation - m_generation : m_generation - generation;
+	const Entry* start = nullptr;
+	if (generation - entry(before).generation < distance) {
+		start = &entry(before);
+		distance = generation - start->generation;
+	}
+	if (after < m_count && entry(after).generation - generation < distance) {
+		start = &entry(after);
+	}
+	if (start) {
+		memcpy(m_board->arr, m_arena.get() + start->offset, start->bytes);
+		m_generation = start->generation;
+	}
+
+	while (m_generation < generation) {
+		apply(entry(find(m_generation + 1, false)));
+		m_generation++;
+	}
+	while (m_generation > generation) {
+		apply(entry(find(m_generation, false)));
+		m_generation--;
+	}
+	return true;
+}
+
+const Grid* History::board() const {
+	return m_board;
+}
+
+uint64_t History::generation() const {
+	return m_generation;
+}
+
+uint64_t History::oldest() const {
+	return m_count ? entry(0).generation : m_generation;
+}
+
+uint64_t History::newest() const {
+	return m_count ? entry(m_count - 1).generation : m_generation;
+}
+
+size_t History::used() const {
+	if (m_count == 0) {
+		return 0;
+	}
+	size_t head = entry(0).offset;
+	return head < m_tail ? m_tail - head : m_capacity - head + m_tail;
+}
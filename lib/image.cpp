@@ -0,0 +1,113 @@
+#include "image.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+// Largest stored deflate block
+const size_t STORED_BLOCK = 65535;
+
+static uint32_t crc32(const uint8_t* data, size_t length, uint32_t crc = 0) {
+	static uint32_t table[256];
+	static bool ready = false;
+	if (!ready) {
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++) {
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+		ready = true;
+	}
+	crc = ~crc;
+	for (size_t i = 0; i < length; i++) {
+		crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+// Sums stay below 2^32 for this many bytes before they need reducing
+static uint32_t adler32(const uint8_t* data, size_t length) {
+	const size_t chunk = 5552;
+	uint32_t a = 1;
+	uint32_t b = 0;
+	while (length > 0) {
+		size_t n = std::min(length, chunk);
+		for (size_t i = 0; i < n; i++) {
+			a += data[i];
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+		data += n;
+		length -= n;
+	}
+	return b << 16 | a;
+}
+
+static void put32(std::vector<uint8_t>* out, uint32_t value) {
+	out->push_back(value >> 24);
+	out->push_back(value >> 16);
+	out->push_back(value >> 8);
+	out->push_back(value);
+}
+
+static void chunk(FILE* file, const char* type, const std::vector<uint8_t>& data) {
+	std::vector<uint8_t> header;
+	put32(&header, data.size());
+	header.insert(header.end(), type, type + 4);
+	uint32_t crc = crc32(header.data() + 4, 4);
+	crc = crc32(data.data(), data.size(), crc);
+	std::vector<uint8_t> footer;
+	put32(&footer, crc);
+	fwrite(header.data(), 1, header.size(), file);
+	fwrite(data.data(), 1, data.size(), file);
+	fwrite(footer.data(), 1, footer.size(), file);
+}
+
+bool write_png(const std::string& path, const uint8_t* rgba, int width, int height) {
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) {
+		return false;
+	}
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	fwrite(signature, 1, sizeof(signature), file);
+
+	std::vector<uint8_t> header;
+	put32(&header, width);
+	put32(&header, height);
+	header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bit RGBA, no interlace
+	chunk(file, "IHDR", header);
+
+	// Every scanline starts with filter type 0, top row first
+	size_t stride = size_t(width) * 4;
+	std::vector<uint8_t> raw;
+	raw.reserve((stride + 1) * height);
+	for (int y = height - 1; y >= 0; y--) {
+		raw.push_back(0);
+		raw.insert(raw.end(), rgba + y * stride, rgba + (y + 1) * stride);
+	}
+
+	std::vector<uint8_t> data = { 0x78, 0x01 };
+	data.reserve(raw.size() + raw.size() / STORED_BLOCK * 5 + 16);
+	for (size_t offset = 0; offset < raw.size() || offset == 0; offset += STORED_BLOCK) {
+		size_t length = std::min(STORED_BLOCK, raw.size() - offset);
+		bool last = offset + length >= raw.size();
+		data.push_back(last ? 1 : 0);
+		data.push_back(length & 0xFF);
+		data.push_back(length >> 8);
+		data.push_back(~length & 0xFF);
+		data.push_back((~length >> 8) & 0xFF);
+		data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + length);
+		if (last) {
+			break;
+		}
+	}
+	put32(&data, adler32(raw.data(), raw.size()));
+	chunk(file, "IDAT", data);
+	chunk(file, "IEND", {});
+
+	bool ok = !ferror(file);
+	fclose(file);
+	return ok;
+}
@@ -0,0 +1,50 @@
+#include "io_queue.h"
+
+IoQueue::IoQueue() {
+	m_queued = 0;
+	m_done = 0;
+	m_stopping = false;
+	m_thread = std::thread(&IoQueue::run, this);
+}
+
+IoQueue::~IoQueue() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_changed.notify_all();
+	m_thread.join();
+}
+
+uint64_t IoQueue::push(std::function<void()> job) {
+	uint64_t ticket;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+		ticket = ++m_queued;
+	}
+	m_changed.notify_all();
+	return ticket;
+}
+
+void IoQueue::wait(uint64_t ticket) {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_changed.wait(lock, [this, ticket] { return m_done >= ticket; });
+}
+
+void IoQueue::run() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		m_changed.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+		if (m_jobs.empty()) {
+			return;
+		}
+		std::function<void()> job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		lock.unlock();
+		job();
+		lock.lock();
+		m_done++;
+		m_changed.notify_all();
+	}
+}
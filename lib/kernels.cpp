@@ -0,0 +1,800 @@
+#include "kernels.h"
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+
+const char CACHE_MAGIC[4] = { 'G', 'O', 'L', 'K' };
+const uint32_t CACHE_VERSION = 1;
+
+/* Cache file layout: magic, version, key, how long the source build took,
+ * binary size, binary */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    double build_ms;
+    uint64_t size;
+} CacheHeader;
+
+// Shared by both programs, built with -D SPECIES, BIRTH and SURVIVE
+static const char* COMMON_SOURCE = R"CLC(
+		#if SPECIES >= 16
+		#define SPECIES_MASK 0x1111111111111111UL
+		#else
+		#define SPECIES_MASK (0x1111111111111111UL & ((1UL << (SPECIES*4)) - 1UL))
+		#endif
+
+		__constant ulong SPECIES_VALUE_MASK  = 0x1111111111111111UL;
+
+		// https://www.reedbeta.com/blog/hash-functions-for-gpu-rendering/
+		uint pcg_hash(uint input) {
+			uint state = input * 747796405u + 2891336453u;
+			uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+			return (word >> 22u) ^ word;
+		}
+
+		// Low bit of every species nibble whose neighbour count is in the
+		// set. The set is a build constant, so this folds to a few masks.
+		ulong counts_in(ulong neighbors, uint set) {
+			ulong result = 0ul;
+			#pragma unroll
+			for (uint n = 0; n <= 8; n++) {
+				if (set & (1u << n)) {
+					ulong x = neighbors ^ (SPECIES_VALUE_MASK * n);
+					x = (x | x >> 1 | x >> 2 | x >> 3) & SPECIES_VALUE_MASK;
+					result |= x ^ SPECIES_VALUE_MASK;
+				}
+			}
+			return result & SPECIES_MASK;
+		}
+
+		// Same key as zobrist() in stepper.h, device boards stay under 2^32 cells
+		ulong zobrist(uint cell, ulong value) {
+			if (!value) {
+				return 0UL;
+			}
+			ulong z = (ulong)cell * 0x9E3779B97F4A7C15UL ^ value * 0xC2B2AE3D27D4EB4FUL;
+			z ^= z >> 33;
+			z *= 0xFF51AFD7ED558CCDUL;
+			z ^= z >> 33;
+			z *= 0xC4CEB9FE1A85EC53UL;
+			z ^= z >> 33;
+			return z;
+		}
+
+		ulong next_cell(ulong value, ulong neighbors, uint rng_input, uint* tied) {
+			// Live cell
+			if (value) {
+				return (counts_in(neighbors, SURVIVE) & value) ? value : 0UL;
+			}
+
+			// Dead cell
+			if (!neighbors) {
+				return 0UL;
+			}
+			ulong born = counts_in(neighbors, BIRTH);
+			if (!(born & (born - 1UL))) {
+				return born;
+			}
+
+			// Several species qualify, drop a random number of the lowest
+			*tied = 1u;
+			uint pick = pcg_hash(rng_input) % (uint)popcount(born);
+			for (; pick; pick--) {
+				born &= born - 1UL;
+			}
+			return born & (~born + 1UL);
+		}
+
+	)CLC";
+
+// Single board kernels, also built with -D WIDTH and HEIGHT
+static const char* KERNEL_SOURCE = R"CLC(
+		#define ROW (WIDTH+2)
+		// Dirty tiles, one bit per TILE x TILE block of cells
+		#define TILE 32
+		#define TILES_X ((WIDTH + TILE - 1) / TILE)
+
+		// hash gathers the Zobrist delta as two halves, ties the births
+		// that needed a random pick
+		kernel void gameOfLife(
+			global ulong* in, 
+			global ulong* out, 
+			ulong seed,
+			volatile global uint* hash,
+			volatile global uint* ties,
+			volatile global uint* dirty
+		) {
+			int gid = get_global_id(0);
+			// Launches with a local size are padded to whole groups
+			if (gid >= WIDTH * HEIGHT) {
+				return;
+			}
+			int x = gid % WIDTH;
+			int y = gid / WIDTH;
+			int i = (y+1) * ROW + (x+1);
+			ulong neighbors = 0ul;
+			neighbors += in[i-ROW-1];
+			neighbors += in[i-ROW];
+			neighbors += in[i-ROW+1];
+			neighbors += in[i-1];
+			neighbors += in[i+1];
+			neighbors += in[i+ROW-1];
+			neighbors += in[i+ROW];
+			neighbors += in[i+ROW+1];
+			ulong value = in[i];
+			uint tied = 0u;
+			ulong next = next_cell(value, neighbors, (uint)seed ^ (uint)gid, &tied);
+			out[i] = next;
+			if (next != value) {
+				ulong z = zobrist(gid, value) ^ zobrist(gid, next);
+				atomic_xor(&hash[0], (uint)z);
+				atomic_xor(&hash[1], (uint)(z >> 32));
+				// Most changes land in a tile that's already marked
+				uint tile = (y / TILE) * TILES_X + x / TILE;
+				uint bit = 1u << (tile % 32);
+				if (!(dirty[tile / 32] & bit)) {
+					atomic_or(&dirty[tile / 32], bit);
+				}
+			}
+			if (tied) {
+				atomic_inc(ties);
+			}
+		}
+
+		// Work groups of the fused kernel are FRAME_TILE x FRAME_TILE cells
+		#define FRAME_TILE 16
+		#define FRAME_POINTS ((FRAME_TILE/2) * (FRAME_TILE/2))
+
+		/* gameOfLife plus everything a frame needs from the generation it
+		 * reads, so the board is read once and written once per frame:
+		 * the region's levels (as reduceLevel, when step <= FRAME_TILE),
+		 * the live cells of every species and, built with -D VALIDATE,
+		 * the cells holding anything but a single species in counts[SPECIES].
+		 * Launched over the board rounded up to whole tiles. */
+		kernel void stepFrame(
+			global ulong* in,
+			global ulong* out,
+			ulong seed,
+			volatile global uint* hash,
+			volatile global uint* ties,
+			volatile global uint* dirty,
+			global uchar2* level,
+			int x0,
+			int y0,
+			int step,
+			int cols,
+			int rows,
+			volatile global uint* counts
+		) {
+			local uint species[SPECIES + 1];
+			local uint points[FRAME_POINTS * SPECIES];
+			int lid = get_local_id(1) * FRAME_TILE + get_local_id(0);
+			for (int k = lid; k < SPECIES + 1; k += FRAME_TILE * FRAME_TILE) {
+				species[k] = 0u;
+			}
+			for (int k = lid; k < FRAME_POINTS * SPECIES; k += FRAME_TILE * FRAME_TILE) {
+				points[k] = 0u;
+			}
+			barrier(CLK_LOCAL_MEM_FENCE);
+
+			int x = get_global_id(0);
+			int y = get_global_id(1);
+			if (x < WIDTH && y < HEIGHT) {
+				int gid = y * WIDTH + x;
+				int i = (y+1) * ROW + (x+1);
+				ulong neighbors = 0ul;
+				neighbors += in[i-ROW-1];
+				neighbors += in[i-ROW];
+				neighbors += in[i-ROW+1];
+				neighbors += in[i-1];
+				neighbors += in[i+1];
+				neighbors += in[i+ROW-1];
+				neighbors += in[i+ROW];
+				neighbors += in[i+ROW+1];
+				ulong value = in[i];
+				uint tied = 0u;
+				ulong next = next_cell(value, neighbors, (uint)seed ^ (uint)gid, &tied);
+				out[i] = next;
+				if (next != value) {
+					ulong z = zobrist(gid, value) ^ zobrist(gid, next);
+					atomic_xor(&hash[0], (uint)z);
+					atomic_xor(&hash[1], (uint)(z >> 32));
+					uint tile = (y / TILE) * TILES_X + x / TILE;
+					uint bit = 1u << (tile % 32);
+					if (!(dirty[tile / 32] & bit)) {
+						atomic_or(&dirty[tile / 32], bit);
+					}
+				}
+				if (tied) {
+					atomic_inc(ties);
+				}
+
+				int s = value ? (63 - clz(value)) / 4 : 0;
+				if (value) {
+					atomic_inc(&species[s]);
+				}
+				#ifdef VALIDATE
+				if ((value & (value - 1UL)) || (value & ~SPECIES_MASK)) {
+					atomic_inc(&species[SPECIES]);
+				}
+				#endif
+
+				int col = (x - x0) / step;
+				int row = (y - y0) / step;
+				if (x >= x0 && y >= y0 && col < cols && row < rows) {
+					if (step == 1) {
+						level[row * cols + col] = value ? (uchar2)((uchar)(s + 1), (uchar)255) : (uchar2)((uchar)0, (uchar)0);
+					} else if (step <= FRAME_TILE && value) {
+						int per = FRAME_TILE / step;
+						int point = (get_local_id(1) / step) * per + get_local_id(0) / step;
+						atomic_inc(&points[point * SPECIES + s]);
+					}
+				}
+			}
+			barrier(CLK_LOCAL_MEM_FENCE);
+
+			if (lid < SPECIES + 1 && species[lid]) {
+				atomic_add(&counts[lid], species[lid]);
+			}
+			// Tiles start on multiples of FRAME_TILE and so of step, every
+			// block of a point lies in one tile
+			int per = FRAME_TILE / step;
+			if (step > 1 && step <= FRAME_TILE && lid < per * per) {
+				int xs = get_group_id(0) * FRAME_TILE + (lid % per) * step;
+				int ys = get_group_id(1) * FRAME_TILE + (lid / per) * step;
+				int col = (xs - x0) / step;
+				int row = (ys - y0) / step;
+				if (xs >= x0 && ys >= y0 && col < cols && row < rows) {
+					uint total = 0;
+					uint best = 0;
+					uchar dominant = 0;
+					for (int k = 0; k < SPECIES; k++) {
+						uint n = points[lid * SPECIES + k];
+						total += n;
+						if (n > best) {
+							best = n;
+							dominant = k + 1;
+						}
+					}
+					uint cells = (min(xs + step, WIDTH) - xs) * (min(ys + step, HEIGHT) - ys);
+					level[row * cols + col] = (uchar2)(dominant, (uchar)(((ulong)total * 255ul) / cells));
+				}
+			}
+		}
+
+		/* In place stepping on one buffer, in IN_PLACE_TILE square tiles.
+		 * saveBorders keeps the old outer rows and columns of every tile in
+		 * borders (top, bottom, left, right), then each stepInPlace group
+		 * reads its own tile from the grid and the ring around it from its
+		 * neighbours' borders, since the neighbours may already be written. */
+		#define IN_PLACE_TILE 32
+		#define IN_PLACE_ROWS 4
+		#define IN_PLACE_TILES_X ((WIDTH + IN_PLACE_TILE - 1) / IN_PLACE_TILE)
+
+		ulong board_cell(global ulong* grid, int x, int y) {
+			return (x < WIDTH && y < HEIGHT) ? grid[(y+1) * ROW + (x+1)] : 0UL;
+		}
+
+		// One work item per tile and position along its edges
+		kernel void saveBorders(
+			global ulong* grid,
+			global ulong* borders
+		) {
+			int gid = get_global_id(0);
+			int tile = gid / IN_PLACE_TILE;
+			int k = gid % IN_PLACE_TILE;
+			int x0 = (tile % IN_PLACE_TILES_X) * IN_PLACE_TILE;
+			int y0 = (tile / IN_PLACE_TILES_X) * IN_PLACE_TILE;
+			global ulong* saved = borders + tile * 4 * IN_PLACE_TILE;
+			saved[k] = board_cell(grid, x0 + k, y0);
+			saved[IN_PLACE_TILE + k] = board_cell(grid, x0 + k, y0 + IN_PLACE_TILE - 1);
+			saved[2 * IN_PLACE_TILE + k] = board_cell(grid, x0, y0 + k);
+			saved[3 * IN_PLACE_TILE + k] = board_cell(grid, x0 + IN_PLACE_TILE - 1, y0 + k);
+		}
+
+		// Old value of a cell just outside the tile at (x0, y0)
+		ulong ring_cell(global const ulong* borders, int x0, int y0, int x, int y) {
+			if (x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT) {
+				return 0UL;
+			}
+			int tx = x / IN_PLACE_TILE;
+			int ty = y / IN_PLACE_TILE;
+			global const ulong* saved = borders + (ty * IN_PLACE_TILES_X + tx) * 4 * IN_PLACE_TILE;
+			if (y < y0) {
+				return saved[IN_PLACE_TILE + x - tx * IN_PLACE_TILE];
+			}
+			if (y >= y0 + IN_PLACE_TILE) {
+				return saved[x - tx * IN_PLACE_TILE];
+			}
+			if (x < x0) {
+				return saved[3 * IN_PLACE_TILE + y - y0];
+			}
+			return saved[2 * IN_PLACE_TILE + y - y0];
+		}
+
+		// IN_PLACE_TILE x (IN_PLACE_TILE / IN_PLACE_ROWS) work groups, every
+		// work item steps IN_PLACE_ROWS cells of one column
+		kernel void stepInPlace(
+			global ulong* grid,
+			global const ulong* borders,
+			ulong seed,
+			volatile global uint* hash,
+			volatile global uint* ties,
+			volatile global uint* dirty
+		) {
+			local ulong cells[IN_PLACE_TILE + 2][IN_PLACE_TILE + 2];
+			int lx = get_local_id(0);
+			int ly = get_local_id(1);
+			int x0 = get_group_id(0) * IN_PLACE_TILE;
+			int y0 = get_group_id(1) * IN_PLACE_TILE;
+			for (int r = 0; r < IN_PLACE_ROWS; r++) {
+				int row = ly * IN_PLACE_ROWS + r;
+				cells[row + 1][lx + 1] = board_cell(grid, x0 + lx, y0 + row);
+			}
+			int lid = ly * IN_PLACE_TILE + lx;
+			if (lid < 4 * IN_PLACE_TILE + 4) {
+				int side = lid / IN_PLACE_TILE;
+				int k = lid % IN_PLACE_TILE;
+				int cx = side == 0 || side == 1 ? k : (side == 2 ? -1 : IN_PLACE_TILE);
+				int cy = side == 2 || side == 3 ? k : (side == 0 ? -1 : IN_PLACE_TILE);
+				if (side == 4) {
+					cx = (k & 1) ? IN_PLACE_TILE : -1;
+					cy = (k & 2) ? IN_PLACE_TILE : -1;
+				}
+				cells[cy + 1][cx + 1] = ring_cell(borders, x0, y0, x0 + cx, y0 + cy);
+			}
+			barrier(CLK_LOCAL_MEM_FENCE);
+
+			for (int r = 0; r < IN_PLACE_ROWS; r++) {
+				int cy = ly * IN_PLACE_ROWS + r + 1;
+				int cx = lx + 1;
+				int x = x0 + lx;
+				int y = y0 + cy - 1;
+				if (x >= WIDTH || y >= HEIGHT) {
+					continue;
+				}
+				ulong value = cells[cy][cx];
+				ulong neighbors = cells[cy-1][cx-1] + cells[cy-1][cx] + cells[cy-1][cx+1]
+					+ cells[cy][cx-1] + cells[cy][cx+1]
+					+ cells[cy+1][cx-1] + cells[cy+1][cx] + cells[cy+1][cx+1];
+				int gid = y * WIDTH + x;
+				uint tied = 0u;
+				ulong next = next_cell(value, neighbors, (uint)seed ^ (uint)gid, &tied);
+				if (next != value) {
+					grid[(y+1) * ROW + (x+1)] = next;
+					ulong z = zobrist(gid, value) ^ zobrist(gid, next);
+					atomic_xor(&hash[0], (uint)z);
+					atomic_xor(&hash[1], (uint)(z >> 32));
+					uint tile = (y / TILE) * TILES_X + x / TILE;
+					uint bit = 1u << (tile % 32);
+					if (!(dirty[tile / 32] & bit)) {
+						atomic_or(&dirty[tile / 32], bit);
+					}
+				}
+				if (tied) {
+					atomic_inc(ties);
+				}
+			}
+		}
+
+		// Dominant species (0 when empty) and density of a step x step block
+		// of cells, one work item per drawn point of the visible region
+		kernel void reduceLevel(
+			global ulong* grid,
+			global uchar2* level,
+			int x0,
+			int y0,
+			int step,
+			int cols
+		) {
+			int gid = get_global_id(0);
+			int xs = x0 + (gid % cols) * step;
+			int ys = y0 + (gid / cols) * step;
+
+			if (step == 1) {
+				ulong value = grid[(ys+1) * ROW + (xs+1)];
+				if (value) {
+					level[gid] = (uchar2)((uchar)((63 - clz(value)) / 4 + 1), (uchar)255);
+				} else {
+					level[gid] = (uchar2)((uchar)0, (uchar)0);
+				}
+				return;
+			}
+
+			int xe = min(xs + step, WIDTH);
+			int ye = min(ys + step, HEIGHT);
+			uint counts[16] = {0};
+			ulong sum = 0ul;
+			int pending = 0;
+			for (int y = ys; y < ye; y++) {
+				for (int x = xs; x < xe; x++) {
+					sum += grid[(y+1) * ROW + (x+1)];
+					// Each nibble holds at most 15 before it carries
+					if (++pending == 15) {
+						for (int s = 0; s < SPECIES; s++) {
+							counts[s] += (sum >> (s*4)) & 0xFUL;
+						}
+						sum = 0ul;
+						pending = 0;
+					}
+				}
+			}
+			for (int s = 0; s < SPECIES; s++) {
+				counts[s] += (sum >> (s*4)) & 0xFUL;
+			}
+
+			uint total = 0;
+			uint best = 0;
+			uchar dominant = 0;
+			for (int s = 0; s < SPECIES; s++) {
+				total += counts[s];
+				if (counts[s] > best) {
+					best = counts[s];
+					dominant = s + 1;
+				}
+			}
+			uint cells = (xe - xs) * (ye - ys);
+			level[gid] = (uchar2)(dominant, (uchar)(((ulong)total * 255ul) / cells));
+		}
+
+		kernel void countCells(
+			global ulong* grid,
+			volatile global uint* totalVertices
+		) {
+			int gid = get_global_id(0);
+			if (gid >= WIDTH * HEIGHT) {
+				return;
+			}
+			int x = gid % WIDTH;
+			int y = gid / WIDTH;
+			if (grid[(y+1) * ROW + (x+1)]) {
+				atomic_inc(totalVertices);
+			}
+		}
+
+	)CLC";
+
+// Many boards packed into one buffer, each padded like a Grid
+static const char* ENSEMBLE_SOURCE = R"CLC(
+		// Last board starting at or before the cell
+		int board_of(global const uint* starts, int boards, uint cell) {
+			int lo = 0;
+			int hi = boards - 1;
+			while (lo < hi) {
+				int mid = (lo + hi + 1) / 2;
+				if (starts[mid] <= cell) {
+					lo = mid;
+				} else {
+					hi = mid - 1;
+				}
+			}
+			return lo;
+		}
+
+		kernel void stepEnsemble(
+			global ulong* in,
+			global ulong* out,
+			global const ulong* offsets,
+			global const uint* starts,
+			global const int* widths,
+			global const uint* seeds,
+			global const uchar* active,
+			global uint* changes,
+			global uint* population,
+			global uint* hashes,
+			global uint* ties,
+			local uint* scratch,
+			local ulong* keys,
+			int boards,
+			uint cells,
+			uint generation
+		) {
+			uint gid = get_global_id(0);
+			uint lid = get_local_id(0);
+			uint size = get_local_size(0);
+			int b = board_of(starts, boards, min(gid, cells - 1));
+
+			uint changed = 0;
+			uint alive = 0;
+			uint tied = 0;
+			ulong key = 0ul;
+			if (gid < cells && active[b]) {
+				int width = widths[b];
+				int row = width + 2;
+				uint cell = gid - starts[b];
+				int x = cell % width;
+				int y = cell / width;
+				int i = (y+1) * row + (x+1);
+				global ulong* board = in + offsets[b];
+				ulong value = board[i];
+				ulong neighbors = 0ul;
+				neighbors += board[i-row-1];
+				neighbors += board[i-row];
+				neighbors += board[i-row+1];
+				neighbors += board[i-1];
+				neighbors += board[i+1];
+				neighbors += board[i+row-1];
+				neighbors += board[i+row];
+				neighbors += board[i+row+1];
+				ulong next = next_cell(value, neighbors, pcg_hash(seeds[b] ^ generation) ^ cell, &tied);
+				out[offsets[b] + i] = next;
+				changed = next != value;
+				alive = next != 0ul;
+				if (changed) {
+					key = zobrist(cell, value) ^ zobrist(cell, next);
+				}
+			}
+
+			// Groups straddling two boards fall back to per cell atomics
+			uint first = gid - lid;
+			uint last = min(first + size, cells) - 1;
+			if (board_of(starts, boards, first) != board_of(starts, boards, last)) {
+				if (changed) {
+					atomic_inc(&changes[b]);
+				}
+				if (alive) {
+					atomic_inc(&population[b]);
+				}
+				if (tied) {
+					atomic_inc(&ties[b]);
+				}
+				if (key) {
+					atomic_xor(&hashes[2*b], (uint)key);
+					atomic_xor(&hashes[2*b+1], (uint)(key >> 32));
+				}
+				return;
+			}
+
+			// Ten bits per count, a group has at most 256 items
+			scratch[lid] = changed | alive << 10 | tied << 20;
+			keys[lid] = key;
+			barrier(CLK_LOCAL_MEM_FENCE);
+			for (uint s = size / 2; s > 0; s >>= 1) {
+				if (lid < s) {
+					scratch[lid] += scratch[lid + s];
+					keys[lid] ^= keys[lid + s];
+				}
+				barrier(CLK_LOCAL_MEM_FENCE);
+			}
+			if (lid == 0 && scratch[0]) {
+				atomic_add(&changes[b], scratch[0] & 0x3FFu);
+				atomic_add(&population[b], (scratch[0] >> 10) & 0x3FFu);
+				if (scratch[0] >> 20) {
+					atomic_add(&ties[b], scratch[0] >> 20);
+				}
+				if (keys[0]) {
+					atomic_xor(&hashes[2*b], (uint)keys[0]);
+					atomic_xor(&hashes[2*b+1], (uint)(keys[0] >> 32));
+				}
+			}
+		}
+
+	)CLC";
+
+std::vector<cl_device_id> list_devices() {
+	std::vector<cl_device_id> devices;
+	cl_uint num_platforms = 0;
+	clGetPlatformIDs(0, nullptr, &num_platforms);
+	if (num_platforms == 0) {
+		return devices;
+	}
+	std::vector<cl_platform_id> platforms(num_platforms);
+	clGetPlatformIDs(num_platforms, platforms.data(), nullptr);
+
+	for (cl_platform_id platform : platforms) {
+		cl_uint num_devices = 0;
+		clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, 0, nullptr, &num_devices);
+		if (num_devices == 0) {
+			continue;
+		}
+		size_t first = devices.size();
+		devices.resize(first + num_devices);
+		clGetDeviceIDs(platform, CL_DEVICE_TYPE_ALL, num_devices, devices.data() + first, nullptr);
+	}
+	return devices;
+}
+
+cl_device_id select_device(int index) {
+	std::vector<cl_device_id> devices = list_devices();
+	if (devices.empty()) {
+		return nullptr;
+	}
+	// The first device of the first platform unless told otherwise, thanks apple
+	if (index < 0 || index >= int(devices.size())) {
+		index = 0;
+	}
+	return devices[index];
+}
+
+std::string kernel_source() {
+	return std::string(COMMON_SOURCE) + KERNEL_SOURCE;
+}
+
+std::string ensemble_kernel_source() {
+	return std::string(COMMON_SOURCE) + ENSEMBLE_SOURCE;
+}
+
+// Species vary per board, all 16 nibbles are live
+std::string ensemble_kernel_options(Rule rule) {
+	char options[96];
+	snprintf(options, sizeof(options), "-D SPECIES=16 -D BIRTH=0x%xu -D SURVIVE=0x%xu", rule.birth, rule.survive);
+	return options;
+}
+
+std::string kernel_options(const Grid* grid, Rule rule, bool validate) {
+	char options[144];
+	snprintf(options, sizeof(options), "-D WIDTH=%d -D HEIGHT=%d -D SPECIES=%d -D BIRTH=0x%xu -D SURVIVE=0x%xu%s",
+		grid->width, grid->height, grid->species, rule.birth, rule.survive, validate ? " -D VALIDATE" : "");
+	return options;
+}
+
+uint64_t fnv1a(uint64_t hash, const std::string& text) {
+	for (unsigned char c : text) {
+		hash ^= c;
+		hash *= 0x100000001B3ULL;
+	}
+	hash ^= 0xFF;
+	hash *= 0x100000001B3ULL;
+	return hash;
+}
+
+static std::string device_string(cl_device_id device, cl_uint param) {
+	size_t length = 0;
+	clGetDeviceInfo(device, param, 0, nullptr, &length);
+	std::vector<char> value(length + 1, '\0');
+	clGetDeviceInfo(device, param, length, value.data(), nullptr);
+	return value.data();
+}
+
+std::string device_name(cl_device_id device) {
+	return device_string(device, CL_DEVICE_NAME) + " (driver " + device_string(device, CL_DRIVER_VERSION) + ")";
+}
+
+static std::filesystem::path cache_directory() {
+	if (const char* dir = getenv("GOL_KERNEL_CACHE")) {
+		return dir;
+	}
+	if (const char* dir = getenv("XDG_CACHE_HOME")) {
+		return std::filesystem::path(dir) / "game-of-life";
+	}
+	if (const char* home = getenv("HOME")) {
+		return std::filesystem::path(home) / ".cache" / "game-of-life";
+	}
+	return std::filesystem::temp_directory_path() / "game-of-life";
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool read_cache(const std::filesystem::path& path, uint64_t key, CacheHeader* header, std::vector<unsigned char>* binary) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.read(reinterpret_cast<char*>(header), sizeof(CacheHeader))) {
+		return false;
+	}
+	if (std::memcmp(header->magic, CACHE_MAGIC, 4) != 0 || header->version != CACHE_VERSION || header->key != key) {
+		return false;
+	}
+	// A truncated or corrupt entry can't claim more than the file holds
+	std::error_code error;
+	uintmax_t length = std::filesystem::file_size(path, error);
+	if (error || header->size == 0 || header->size > length - sizeof(CacheHeader)) {
+		return false;
+	}
+	binary->resize(header->size);
+	return (bool)file.read(reinterpret_cast<char*>(binary->data()), header->size);
+}
+
+static void write_cache(const std::filesystem::path& path, uint64_t key, double build_ms, cl_program program) {
+	size_t binarySize = 0;
+	if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &binarySize, nullptr) != CL_SUCCESS || binarySize == 0) {
+		return;
+	}
+	std::vector<unsigned char> binary(binarySize);
+	unsigned char* binaries[] = { binary.data() };
+	if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binaries), binaries, nullptr) != CL_SUCCESS) {
+		return;
+	}
+
+	CacheHeader header;
+	std::memcpy(header.magic, CACHE_MAGIC, 4);
+	header.version = CACHE_VERSION;
+	header.key = key;
+	header.build_ms = build_ms;
+	header.size = binarySize;
+
+	// Write then rename, so a concurrent launch never reads half a file
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+	std::filesystem::path temporary = path;
+	temporary += ".tmp" + std::to_string(getpid());
+	{
+		std::ofstream file(temporary, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(binary.data()), binarySize);
+		if (!file) {
+			std::filesystem::remove(temporary, error);
+			return;
+		}
+	}
+	std::filesystem::rename(temporary, path, error);
+}
+
+static void print_build_log(cl_program program, cl_device_id device) {
+	size_t logSize = 0;
+	clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, nullptr, &logSize);
+	std::vector<char> log(logSize + 1, '\0');
+	clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, logSize, log.data(), nullptr);
+	std::cerr << "Build Log:\n" << log.data() << "\n";
+}
+
+cl_program build_program(
+	cl_context ctx,
+	cl_device_id device,
+	const std::string& source,
+	const std::string& options,
+	bool use_cache
+) {
+	cl_int err;
+	auto start = std::chrono::steady_clock::now();
+
+	uint64_t key = FNV_OFFSET_BASIS;
+	key = fnv1a(key, device_string(device, CL_DEVICE_NAME));
+	key = fnv1a(key, device_string(device, CL_DEVICE_VERSION));
+	key = fnv1a(key, device_string(device, CL_DRIVER_VERSION));
+	key = fnv1a(key, source);
+	key = fnv1a(key, options);
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+	std::filesystem::path path = cache_directory() / name;
+
+	CacheHeader header;
+	std::vector<unsigned char> binary;
+	if (use_cache && read_cache(path, key, &header, &binary)) {
+		size_t binarySize = binary.size();
+		const unsigned char* binaries[] = { binary.data() };
+		cl_int status;
+		cl_program program = clCreateProgramWithBinary(ctx, 1, &device, &binarySize, binaries, &status, &err);
+		if (err == CL_SUCCESS && status == CL_SUCCESS) {
+			err = clBuildProgram(program, 1, &device, options.c_str(), nullptr, nullptr);
+			if (err == CL_SUCCESS) {
+				double load_ms = elapsed_ms(start);
+				std::cout << "Loaded cached kernels in " << std::round(load_ms) << "ms (saved "
+					<< std::round(header.build_ms - load_ms) << "ms of " << std::round(header.build_ms) << "ms build)\n";
+				return program;
+			}
+		}
+		if (program) {
+			clReleaseProgram(program);
+		}
+		std::cout << "Cached kernels are stale, rebuilding\n";
+		std::error_code error;
+		std::filesystem::remove(path, error);
+	}
+
+	const char* kernelSrc = source.c_str();
+	size_t srcLen = source.size();
+	cl_program program = clCreateProgramWithSource(ctx, 1, &kernelSrc, &srcLen, &err);
+	err = clBuildProgram(program, 1, &device, options.c_str(), nullptr, nullptr);
+	if (err != CL_SUCCESS) {
+		print_build_log(program, device);
+		clReleaseProgram(program);
+		return nullptr;
+	}
+
+	double build_ms = elapsed_ms(start);
+	std::cout << "Built kernels from source in " << std::round(build_ms) << "ms\n";
+	if (use_cache) {
+		write_cache(path, key, build_ms, program);
+	}
+	return program;
+}
@@ -0,0 +1,106 @@
+#include "level.h"
+#include <algorithm>
+#include "stepper.h"
+#include "oneapi/tbb/blocked_range2d.h"
+#include "oneapi/tbb/parallel_for.h"
+
+using namespace oneapi;
+
+static void reduce_point(const Grid* grid, int xs, int ys, int step, uint8_t* level) {
+	int dx = grid->width + 2;
+	if (step == 1) {
+		uint64_t value = grid->arr[(ys+1) * dx + (xs+1)];
+		level[0] = value ? __builtin_ctzll(value) / 4 + 1 : 0;
+		level[1] = value ? 255 : 0;
+		return;
+	}
+
+	int xe = std::min(xs + step, grid->width);
+	int ye = std::min(ys + step, grid->height);
+	uint32_t counts[16] = {0};
+	uint64_t sum = 0;
+	int pending = 0;
+	for (int y = ys; y < ye; y++) {
+		const uint64_t* row = grid->arr + (y+1) * dx + 1;
+		for (int x = xs; x < xe; x++) {
+			sum += row[x];
+			// Each nibble holds at most 15 before it carries
+			if (++pending == 15) {
+				for (int s = 0; s < grid->species; s++) {
+					counts[s] += (sum >> (s*4)) & 0xF;
+				}
+				sum = 0;
+				pending = 0;
+			}
+		}
+	}
+	for (int s = 0; s < grid->species; s++) {
+		counts[s] += (sum >> (s*4)) & 0xF;
+	}
+
+	uint32_t total = 0;
+	uint32_t best = 0;
+	uint8_t dominant = 0;
+	for (int s = 0; s < grid->species; s++) {
+		total += counts[s];
+		if (counts[s] > best) {
+			best = counts[s];
+			dominant = s + 1;
+		}
+	}
+	uint32_t cells = (xe - xs) * (ye - ys);
+	level[0] = dominant;
+	level[1] = uint64_t(total) * 255 / cells;
+}
+
+void reduce_level_rows(const Grid* grid, const Region& region, int row_begin, int row_end, uint8_t* levels) {
+	for (int row = row_begin; row < row_end; row++) {
+		for (int col = 0; col < region.cols; col++) {
+			int xs = region.x + col * region.step;
+			int ys = region.y + row * region.step;
+			reduce_point(grid, xs, ys, region.step, levels + (row * region.cols + col) * 2);
+		}
+	}
+}
+
+void count_species(const Grid* grid, int y_begin, int y_end, bool validate, SpeciesCounts* counts) {
+	uint64_t mask = grid->species >= 16 ? SPECIES_VALUE_MASK : SPECIES_VALUE_MASK & ((1ULL << (grid->species * 4)) - 1);
+	for (int y = y_begin; y < y_end; y++) {
+		const uint64_t* row = grid->arr + (y+1) * (grid->width+2) + 1;
+		// Nibble sums as in reduce_point, flushed before any can carry
+		uint64_t sum = 0;
+		int pending = 0;
+		for (int x = 0; x < grid->width; x++) {
+			uint64_t value = row[x];
+			sum += value;
+			counts->population += value != 0;
+			if (validate && ((value & (value - 1)) || (value & ~mask))) {
+				counts->invalid++;
+			}
+			if (++pending == 15) {
+				for (int s = 0; s < grid->species; s++) {
+					counts->species[s] += (sum >> (s*4)) & 0xF;
+				}
+				sum = 0;
+				pending = 0;
+			}
+		}
+		for (int s = 0; s < grid->species; s++) {
+			counts->species[s] += (sum >> (s*4)) & 0xF;
+		}
+	}
+}
+
+void reduce_level(const Grid* grid, const Region& region, uint8_t* levels) {
+	tbb::parallel_for(tbb::blocked_range2d<int, int>(0, region.rows, 0, region.cols),
+		[grid, &region, levels](const tbb::blocked_range2d<int, int>& r) {
+			for (int row = r.rows().begin(); row < r.rows().end(); row++) {
+				for (int col = r.cols().begin(); col < r.cols().end(); col++) {
+					int xs = region.x + col * region.step;
+					int ys = region.y + row * region.step;
+					reduce_point(grid, xs, ys, region.step, levels + (row * region.cols + col) * 2);
+				}
+			}
+		}
+	);
+}
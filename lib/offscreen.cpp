@@ -0,0 +1,270 @@
+#include "offscreen.h"
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include "image.h"
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#ifdef HAVE_EGL
+static EGLDisplay egl_display = EGL_NO_DISPLAY;
+static EGLContext egl_context = EGL_NO_CONTEXT;
+static EGLSurface egl_surface = EGL_NO_SURFACE;
+
+static bool has_extension(EGLDisplay display, const char* name) {
+	const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+	return extensions && strstr(extensions, name);
+}
+#endif
+
+bool offscreen_init() {
+#ifdef HAVE_EGL
+	// Prefer a display that needs no window system at all
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay && has_extension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+		egl_display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	}
+	if (egl_display == EGL_NO_DISPLAY) {
+		egl_display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	EGLint major;
+	EGLint minor;
+	if (egl_display == EGL_NO_DISPLAY || !eglInitialize(egl_display, &major, &minor)) {
+		std::cout << "No EGL display available\n";
+		return false;
+	}
+	eglBindAPI(EGL_OPENGL_API);
+
+	bool surfaceless = has_extension(egl_display, "EGL_KHR_surfaceless_context");
+	const EGLint configAttributes[] = {
+		EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configs = 0;
+	if (!eglChooseConfig(egl_display, configAttributes, &config, 1, &configs) || configs == 0) {
+		std::cout << "No EGL config for desktop OpenGL\n";
+		return false;
+	}
+
+	// Same 4.1 core profile the window asks GLFW for
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 1,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	egl_context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (egl_context == EGL_NO_CONTEXT) {
+		std::cout << "Could not create an OpenGL 4.1 context on EGL\n";
+		return false;
+	}
+	// Everything draws into the recorder's FBO, the surface is never shown
+	if (!surfaceless) {
+		const EGLint pbufferAttributes[] = { EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE };
+		egl_surface = eglCreatePbufferSurface(egl_display, config, pbufferAttributes);
+	}
+	if (!eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context)) {
+		std::cout << "Could not make the EGL context current\n";
+		return false;
+	}
+
+	GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// GLEW built for GLX still loads the GL entry points before failing here
+	if (err == GLEW_ERROR_NO_GLX_DISPLAY) {
+		err = GLEW_OK;
+	}
+#endif
+	if (err != GLEW_OK) {
+		std::cout << "Could not load OpenGL functions on EGL\n";
+		return false;
+	}
+	std::cout << "Rendering offscreen with EGL " << major << "." << minor << " on " << glGetString(GL_RENDERER) << "\n";
+	return true;
+#else
+	std::cout << "Built without EGL, offscreen rendering is unavailable\n";
+	return false;
+#endif
+}
+
+void offscreen_terminate() {
+#ifdef HAVE_EGL
+	if (egl_display == EGL_NO_DISPLAY) {
+		return;
+	}
+	eglMakeCurrent(egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (egl_surface != EGL_NO_SURFACE) {
+		eglDestroySurface(egl_display, egl_surface);
+	}
+	if (egl_context != EGL_NO_CONTEXT) {
+		eglDestroyContext(egl_display, egl_context);
+	}
+	eglTerminate(egl_display);
+	egl_display = EGL_NO_DISPLAY;
+#endif
+}
+
+FrameRecorder::FrameRecorder(int width, int height, const std::string& target) {
+	m_width = width;
+	m_height = height;
+	m_ok = true;
+	m_stream = nullptr;
+	m_pipe = false;
+	m_drawn = 0;
+	m_collected = 0;
+	m_reported = false;
+
+	m_lost = 0;
+
+	if (target == "-") {
+		m_stream = stdout;
+	} else if (target[0] == '|') {
+		m_stream = popen(target.c_str() + 1, "w");
+		m_pipe = true;
+	} else if (std::filesystem::path(target).has_extension()) {
+		m_stream = fopen(target.c_str(), "wb");
+	} else {
+		std::error_code error;
+		std::filesystem::create_directories(target, error);
+		m_directory = target;
+		m_ok = !error;
+	}
+	if (m_directory.empty() && !m_stream) {
+		m_ok = false;
+	}
+	if (!m_ok) {
+		std::cerr << "Could not open " << target << " for frames\n";
+	}
+	// An encoder or reader that exits shows up as a failed write, not a signal
+	if (m_stream && (m_pipe || m_stream == stdout)) {
+		signal(SIGPIPE, SIG_IGN);
+	}
+
+	glGenFramebuffers(1, &m_fbo);
+	glGenRenderbuffers(1, &m_color);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_color);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_color);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cerr << "Offscreen framebuffer is incomplete\n";
+		m_ok = false;
+	}
+
+	glGenBuffers(RECORD_PBOS, m_pbos);
+	for (int i = 0; i < RECORD_PBOS; i++) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[i]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, size_t(width) * height * 4, nullptr, GL_STREAM_READ);
+		m_fences[i] = nullptr;
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+FrameRecorder::~FrameRecorder() {
+	finish();
+	if (m_pipe) {
+		pclose(m_stream);
+	} else if (m_stream && m_stream != stdout) {
+		fclose(m_stream);
+	}
+	glDeleteBuffers(RECORD_PBOS, m_pbos);
+	glDeleteRenderbuffers(1, &m_color);
+	glDeleteFramebuffers(1, &m_fbo);
+}
+
+bool FrameRecorder::ok() const {
+	return m_ok;
+}
+
+void FrameRecorder::begin() {
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+	glViewport(0, 0, m_width, m_height);
+}
+
+// Starts the copy into this frame's PBO, the pixels are mapped later
+void FrameRecorder::end() {
+	if (m_drawn - m_collected >= RECORD_PBOS) {
+		collect();
+	}
+	int slot = m_drawn % RECORD_PBOS;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[slot]);
+	glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	m_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+	m_drawn++;
+}
+
+// Maps the oldest frame in flight and hands it to the writer thread
+void FrameRecorder::collect() {
+	int frame = m_collected++;
+	int slot = frame % RECORD_PBOS;
+	glClientWaitSync(m_fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(10) * 1000 * 1000 * 1000);
+	glDeleteSync(m_fences[slot]);
+	m_fences[slot] = nullptr;
+
+	size_t bytes = size_t(m_width) * m_height * 4;
+	auto pixels = std::make_shared<std::vector<uint8_t>>(bytes);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbos[slot]);
+	const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+	if (mapped) {
+		memcpy(pixels->data(), mapped, bytes);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	// Drawing only waits when the disk or encoder falls this far behind
+	while (m_tickets.size() >= RECORD_BACKLOG) {
+		m_io.wait(m_tickets.front());
+		m_tickets.pop_front();
+	}
+	m_tickets.push_back(m_io.push([this, frame, pixels] {
+		if (!m_directory.empty()) {
+			char name[32];
+			snprintf(name, sizeof(name), "frame_%06d.png", frame);
+			if (!write_png((std::filesystem::path(m_directory) / name).string(), pixels->data(), m_width, m_height)) {
+				m_lost++;
+			}
+			return;
+		}
+		// Raw frames come out bottom row first, encoders take -vf vflip
+		if (fwrite(pixels->data(), 1, pixels->size(), m_stream) != pixels->size()) {
+			m_lost++;
+		}
+	}));
+}
+
+bool FrameRecorder::finish() {
+	while (m_collected < m_drawn) {
+		collect();
+	}
+	while (!m_tickets.empty()) {
+		m_io.wait(m_tickets.front());
+		m_tickets.pop_front();
+	}
+	if (m_stream && fflush(m_stream) != 0 && !m_lost) {
+		// Buffered frames that never reached the target
+		m_lost = 1;
+	}
+	if (m_lost && !m_reported) {
+		std::cerr << m_lost << " of " << m_collected << " frames could not be written\n";
+		m_reported = true;
+	}
+	return m_lost == 0;
+}
+
+int FrameRecorder::frames() const {
+	return m_collected;
+}
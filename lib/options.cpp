@@ -0,0 +1,156 @@
+#include "options.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include "tuner.h"
+
+// Value following a --flag, or nullptr when the flag isn't given
+static const char* find_argument(int argc, char* argv[], const char* flag) {
+	for (int i=1; i < argc - 1; i++) {
+		if (std::string(argv[i]) == flag) {
+			return argv[i+1];
+		}
+	}
+	return nullptr;
+}
+
+static bool has_flag(int argc, char* argv[], const char* flag) {
+	for (int i=1; i < argc; i++) {
+		if (std::string(argv[i]) == flag) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static int parse_species_arguments(int argc, char* argv[]) {
+	int species = 5;
+	if (argc >= 2 && argv[1][0] != '-') {
+		int species_arg = atoi(argv[1]);
+		if (species_arg >= 5 && species_arg <= 10) {
+			std::cout << "Starting game of life with " << species_arg << " species\n";
+			species = species_arg;
+		} else if (argc >= 3 && species_arg >= 1) {
+			if (std::string(argv[2]) == "--force") {
+				if (species_arg > MAX_SPECIES) {
+					std::cout << "Only " << MAX_SPECIES << " colors are supported, defaulting to " << MAX_SPECIES << "\n";
+					species = MAX_SPECIES;
+				} else {
+					std::cout << "Starting game of life with " << species_arg << " species\n";
+					species = species_arg;
+				}
+			} else {
+				std::cout << argv[2] << "\n";
+			}
+		} else {
+			std::cout << "Invalid argument was given, defaulting to 5\n";
+		}
+	} else {
+		std::cout << "Defaulting to 5 species since none were entered\n";
+	}
+	return species;
+}
+
+// --size WIDTHxHEIGHT lets the board be larger (or smaller) than the window
+static void parse_size_arguments(int argc, char* argv[], int* width, int* height, int max_size) {
+	const char* size = find_argument(argc, argv, "--size");
+	if (!size) {
+		return;
+	}
+	int w = 0;
+	int h = 0;
+	if (sscanf(size, "%dx%d", &w, &h) == 2 && w > 0 && h > 0 && w <= max_size && h <= max_size) {
+		std::cout << "Using a " << w << "x" << h << " board\n";
+		*width = w;
+		*height = h;
+	} else {
+		std::cout << "Invalid board size " << size << ", expected WIDTHxHEIGHT up to " << max_size << "\n";
+	}
+}
+
+Options parse_options(int argc, char* argv[], int board_width, int board_height) {
+	Options options;
+	options.species = parse_species_arguments(argc, argv);
+	options.board_width = board_width;
+	options.board_height = board_height;
+
+	const char* batch = find_argument(argc, argv, "--batch");
+	options.batch = batch ? batch : "";
+	const char* stats = find_argument(argc, argv, "--stats");
+	options.stats = stats ? stats : "batch_stats.csv";
+	const char* serve = find_argument(argc, argv, "--serve");
+	options.serve = serve ? serve : "";
+	const char* every = find_argument(argc, argv, "--every");
+	options.every = every ? std::max(atoi(every), 1) : 1;
+	const char* attach = find_argument(argc, argv, "--attach");
+	options.attach = attach ? attach : "";
+	const char* generations = find_argument(argc, argv, "--generations");
+	// A server runs until it's stopped unless told otherwise
+	options.generations = generations ? atoi(generations) : (serve ? 0 : 1000);
+	if (batch) {
+		// Sweeps want many small boards rather than one the size of the window
+		options.board_width = 128;
+		options.board_height = 128;
+	}
+	const char* out_of_core = find_argument(argc, argv, "--out-of-core");
+	options.out_of_core = out_of_core ? out_of_core : "";
+	const char* window = find_argument(argc, argv, "--window");
+	options.window = window ? size_t(std::max(atoi(window), 1)) << 20 : DEFAULT_WINDOW_BYTES;
+	// Boards on disk aren't limited by memory
+	parse_size_arguments(argc, argv, &options.board_width, &options.board_height, out_of_core ? MAX_OUT_OF_CORE_SIZE : MAX_BOARD_SIZE);
+
+	options.rule = CONWAY;
+	const char* rule = find_argument(argc, argv, "--rule");
+	if (rule) {
+		if (parse_rule(rule, &options.rule)) {
+			std::cout << "Using rule " << rule_string(options.rule) << "\n";
+		} else {
+			std::cout << "Invalid rule " << rule << ", defaulting to " << rule_string(CONWAY) << "\n";
+		}
+	}
+
+	options.settings = DEFAULT_SETTINGS;
+	const char* backend = find_argument(argc, argv, "--backend");
+	if (backend && !parse_backend(backend, &options.settings.backend)) {
+		std::cout << "Unknown backend " << backend << ", defaulting to " << backend_name(options.settings.backend) << "\n";
+	}
+	options.settings.kernel_cache = !has_flag(argc, argv, "--no-kernel-cache");
+	options.settings.validate = has_flag(argc, argv, "--validate");
+	options.settings.in_place = has_flag(argc, argv, "--in-place");
+	const char* device = find_argument(argc, argv, "--device");
+	if (device) {
+		options.settings.device = std::max(atoi(device), 0);
+	}
+	options.autotune = has_flag(argc, argv, "--autotune");
+	// A backend or device asked for by name beats whatever was tuned
+	if (!backend && !device && !options.autotune && !has_flag(argc, argv, "--no-profile") &&
+			load_profile(options.board_width, options.board_height, options.species, options.rule, &options.settings)) {
+		std::cout << "Using tuned " << settings_string(options.settings) << "\n";
+	}
+
+	// Always seeded, so any run can be replayed from the seed it prints
+	const char* seed = find_argument(argc, argv, "--seed");
+	if (seed) {
+		options.settings.seed = strtoull(seed, nullptr, 0);
+	} else {
+		std::random_device device;
+		options.settings.seed = uint64_t(device()) << 32 | device();
+	}
+	std::cout << "Seed " << options.settings.seed << "\n";
+
+	const char* check = find_argument(argc, argv, "--check");
+	options.check = check ? check : "";
+	options.offscreen = has_flag(argc, argv, "--offscreen");
+	const char* record = find_argument(argc, argv, "--record");
+	options.record = record ? record : "";
+	const char* history = find_argument(argc, argv, "--history");
+	// Off unless asked for, keeping it means reading back and diffing the whole board every frame
+	options.history = history ? size_t(std::max(atoi(history), 0)) << 20 : 0;
+	const char* pattern = find_argument(argc, argv, "--pattern");
+	options.pattern = pattern ? pattern : "";
+	options.perf = has_flag(argc, argv, "--perf");
+	return options;
+}
@@ -0,0 +1,288 @@
+#include "out_of_core.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char BOARD_MAGIC[4] = { 'G', 'O', 'L', 'B' };
+const uint32_t BOARD_VERSION = 1;
+const size_t HEADER_BYTES = 4096;
+
+// madvise and msync want whole pages
+static void page_range(void* start, size_t bytes, void** page_start, size_t* page_bytes) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	uintptr_t begin = uintptr_t(start) / page * page;
+	uintptr_t end = uintptr_t(start) + bytes;
+	*page_start = (void*)begin;
+	*page_bytes = end - begin;
+}
+
+static void* map_file(int fd, size_t bytes) {
+	void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (memory == MAP_FAILED) {
+		return nullptr;
+	}
+	// Every generation sweeps the file from top to bottom
+	madvise(memory, bytes, MADV_SEQUENTIAL);
+	return memory;
+}
+
+bool save_board(const std::string& path, const BoardFileHeader& header, const Grid* grid) {
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file) {
+		std::cerr << "Could not create " << path << ": " << strerror(errno) << "\n";
+		return false;
+	}
+	std::vector<char> page(HEADER_BYTES, 0);
+	BoardFileHeader* written = (BoardFileHeader*)page.data();
+	*written = header;
+	memcpy(written->magic, BOARD_MAGIC, sizeof(BOARD_MAGIC));
+	written->version = BOARD_VERSION;
+	size_t cells = size_t(grid->width + 2) * (grid->height + 2);
+	bool ok = fwrite(page.data(), 1, HEADER_BYTES, file) == HEADER_BYTES
+		&& fwrite(grid->arr, sizeof(uint64_t), cells, file) == cells;
+	ok = fclose(file) == 0 && ok;
+	if (!ok) {
+		std::cerr << "Could not write " << path << "\n";
+	}
+	return ok;
+}
+
+Grid* load_board(const std::string& path, BoardFileHeader* header) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) {
+		return nullptr;
+	}
+	std::vector<char> page(HEADER_BYTES);
+	if (fread(page.data(), 1, HEADER_BYTES, file) != HEADER_BYTES) {
+		fclose(file);
+		return nullptr;
+	}
+	*header = *(const BoardFileHeader*)page.data();
+	if (memcmp(header->magic, BOARD_MAGIC, sizeof(BOARD_MAGIC)) != 0 || header->version != BOARD_VERSION
+		|| header->width <= 0 || header->height <= 0 || header->width > MAX_OUT_OF_CORE_SIZE || header->height > MAX_OUT_OF_CORE_SIZE) {
+		std::cerr << path << " is not a board file\n";
+		fclose(file);
+		return nullptr;
+	}
+	if (header->width > MAX_BOARD_SIZE || header->height > MAX_BOARD_SIZE) {
+		std::cerr << path << " is too large to load into memory, step it with --out-of-core\n";
+		fclose(file);
+		return nullptr;
+	}
+	Grid* grid = new Grid;
+	grid->width = header->width;
+	grid->height = header->height;
+	grid->species = header->species;
+	grid->arr = new uint64_t[size(grid)];
+	bool ok = fread(grid->arr, sizeof(uint64_t), size(grid), file) == size(grid);
+	fclose(file);
+	if (!ok) {
+		std::cerr << path << " is truncated\n";
+		grid_free(grid);
+		return nullptr;
+	}
+	return grid;
+}
+
+OutOfCoreBoard* OutOfCoreBoard::create(const std::string& path, int width, int height, int species, Rule rule, uint64_t seed) {
+	size_t bytes = HEADER_BYTES + size_t(width + 2) * (height + 2) * sizeof(uint64_t);
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		std::cerr << "Could not create " << path << ": " << strerror(errno) << "\n";
+		return nullptr;
+	}
+	// Sparse on most filesystems, the halo and empty rows cost nothing until written
+	if (ftruncate(fd, bytes) != 0) {
+		std::cerr << "Could not size " << path << ": " << strerror(errno) << "\n";
+		close(fd);
+		return nullptr;
+	}
+	void* memory = map_file(fd, bytes);
+	close(fd);
+	if (!memory) {
+		std::cerr << "Could not map " << path << ": " << strerror(errno) << "\n";
+		return nullptr;
+	}
+
+	BoardFileHeader* header = (BoardFileHeader*)memory;
+	memcpy(header->magic, BOARD_MAGIC, sizeof(BOARD_MAGIC));
+	header->version = BOARD_VERSION;
+	header->width = width;
+	header->height = height;
+	header->species = species;
+	header->birth = rule.birth;
+	header->survive = rule.survive;
+	header->seed = seed;
+	header->generation = 0;
+	header->population = 0;
+	header->hash = 0;
+
+	OutOfCoreBoard* board = new OutOfCoreBoard(path, memory, bytes);
+	// Same rows grid_seed would give a board this size
+	std::mt19937_64 rng(seed);
+	int density = default_density(species);
+	size_t rowBytes = board->m_rowCells * sizeof(uint64_t);
+	for (int y = 0; y < height; y++) {
+		uint64_t* cells = board->row(y + 1) + 1;
+		seed_row(cells, width, species, density, &rng);
+		uint64_t gid = uint64_t(y) * width;
+		for (int x = 0; x < width; x++) {
+			header->population += cells[x] != 0;
+			header->hash ^= zobrist(gid + x, cells[x]);
+		}
+		// Written rows don't need to stay resident
+		if (y % 64 == 63) {
+			void* start;
+			size_t length;
+			page_range(board->row(y - 62), 64 * rowBytes, &start, &length);
+			madvise(start, length, MADV_DONTNEED);
+		}
+	}
+	msync(memory, bytes, MS_ASYNC);
+	return board;
+}
+
+OutOfCoreBoard* OutOfCoreBoard::open(const std::string& path) {
+	int fd = ::open(path.c_str(), O_RDWR);
+	if (fd < 0) {
+		return nullptr;
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0 || size_t(info.st_size) < HEADER_BYTES) {
+		close(fd);
+		return nullptr;
+	}
+	void* memory = map_file(fd, info.st_size);
+	close(fd);
+	if (!memory) {
+		return nullptr;
+	}
+	BoardFileHeader* header = (BoardFileHeader*)memory;
+	size_t expected = HEADER_BYTES + size_t(header->width + 2) * (header->height + 2) * sizeof(uint64_t);
+	if (memcmp(header->magic, BOARD_MAGIC, sizeof(BOARD_MAGIC)) != 0 || header->version != BOARD_VERSION || expected != size_t(info.st_size)) {
+		std::cerr << path << " is not a board file\n";
+		munmap(memory, info.st_size);
+		return nullptr;
+	}
+	return new OutOfCoreBoard(path, memory, info.st_size);
+}
+
+OutOfCoreBoard::OutOfCoreBoard(const std::string& path, void* memory, size_t bytes) {
+	m_path = path;
+	m_memory = memory;
+	m_bytes = bytes;
+	m_header = (BoardFileHeader*)memory;
+	m_rowCells = size_t(m_header->width) + 2;
+	m_stepper = new CpuStepper(m_header->species, Rule{ m_header->birth, m_header->survive });
+	setWindow(DEFAULT_WINDOW_BYTES);
+}
+
+OutOfCoreBoard::~OutOfCoreBoard() {
+	msync(m_memory, m_bytes, MS_SYNC);
+	munmap(m_memory, m_bytes);
+	delete m_stepper;
+}
+
+uint64_t* OutOfCoreBoard::row(int64_t padded_y) const {
+	return (uint64_t*)((char*)m_memory + HEADER_BYTES) + padded_y * m_rowCells;
+}
+
+// Four band buffers of band rows plus halo, at least one row per band
+void OutOfCoreBoard::setWindow(size_t bytes) {
+	size_t rowBytes = m_rowCells * sizeof(uint64_t);
+	int64_t rows = int64_t(bytes / (4 * rowBytes)) - 2;
+	m_bandRows = std::max<int64_t>(1, std::min<int64_t>(rows, m_header->height));
+	for (int b = 0; b < 2; b++) {
+		m_in[b].assign((m_bandRows + 2) * m_rowCells, 0);
+		m_out[b].assign((m_bandRows + 2) * m_rowCells, 0);
+	}
+	m_saved.assign(m_rowCells, 0);
+}
+
+/* Rows 1 and on of buffer get the band and the row below it, row 0 is the
+ * saved row from the band before */
+void OutOfCoreBoard::load(int band, uint64_t* buffer) {
+	int64_t y0 = int64_t(band) * m_bandRows;
+	int rows = std::min<int64_t>(m_bandRows, m_header->height - y0);
+	memcpy(buffer + m_rowCells, row(y0 + 1), (rows + 1) * m_rowCells * sizeof(uint64_t));
+
+	// Start reading the band after this one ahead of time
+	int64_t next = y0 + rows;
+	if (next < m_header->height) {
+		int next_rows = std::min<int64_t>(m_bandRows, m_header->height - next);
+		void* start;
+		size_t length;
+		page_range(row(next + 1), (next_rows + 1) * m_rowCells * sizeof(uint64_t), &start, &length);
+		madvise(start, length, MADV_WILLNEED);
+	}
+}
+
+void OutOfCoreBoard::store(int band, const uint64_t* buffer) {
+	int64_t y0 = int64_t(band) * m_bandRows;
+	int rows = std::min<int64_t>(m_bandRows, m_header->height - y0);
+	size_t bytes = rows * m_rowCells * sizeof(uint64_t);
+	memcpy(row(y0 + 1), buffer + m_rowCells, bytes);
+
+	// Start the writeback and let the pages go, this band is done for the generation
+	void* start;
+	size_t length;
+	page_range(row(y0 + 1), bytes, &start, &length);
+	msync(start, length, MS_ASYNC);
+	madvise(start, length, MADV_DONTNEED);
+}
+
+StepStats OutOfCoreBoard::step() {
+	int height = m_header->height;
+	int bands = (height + m_bandRows - 1) / m_bandRows;
+	uint64_t seed = generation_seed(m_header->seed, m_header->generation);
+	size_t rowBytes = m_rowCells * sizeof(uint64_t);
+
+	// The top halo is the saved row of the first band
+	std::fill(m_saved.begin(), m_saved.end(), 0);
+	uint64_t loaded[2];
+	loaded[0] = m_io.push([this] { load(0, m_in[0].data()); });
+	uint64_t stored = 0;
+
+	StepStats stats = { 0, 0, 0, 0 };
+	for (int band = 0; band < bands; band++) {
+		int current = band % 2;
+		int next = (band + 1) % 2;
+		// Queued after the store of band - 2, so this out buffer is free again
+		m_io.wait(loaded[current]);
+		if (band + 1 < bands) {
+			loaded[next] = m_io.push([this, band, next] { load(band + 1, m_in[next].data()); });
+		}
+
+		uint64_t* in = m_in[current].data();
+		memcpy(in, m_saved.data(), rowBytes);
+		int y0 = band * m_bandRows;
+		int rows = std::min(m_bandRows, height - y0);
+		Grid band_in = { rows, m_header->width, m_header->species, in };
+		Grid band_out = { rows, m_header->width, m_header->species, m_out[current].data() };
+		stats = stats + m_stepper->step(&band_in, &band_out, seed, y0);
+
+		// The file row is about to be overwritten, keep the old one as the next halo
+		memcpy(m_saved.data(), in + rows * m_rowCells, rowBytes);
+		stored = m_io.push([this, band, current] { store(band, m_out[current].data()); });
+	}
+	m_io.wait(stored);
+
+	m_header->generation++;
+	m_header->population = stats.population;
+	m_header->hash ^= stats.hash;
+	msync(m_memory, HEADER_BYTES, MS_ASYNC);
+	return stats;
+}
+
+const BoardFileHeader& OutOfCoreBoard::header() const {
+	return *m_header;
+}
+
+int OutOfCoreBoard::bandRows() const {
+	return m_bandRows;
+}
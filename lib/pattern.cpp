@@ -0,0 +1,122 @@
+#include "pattern.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+bool parse_rle(const std::string& text, Pattern* pattern) {
+	std::istringstream lines(text);
+	std::string line;
+	int width = -1;
+	int height = -1;
+	std::string body;
+	while (std::getline(lines, line)) {
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		// x = 3, y = 3, rule = B3/S23
+		if (width < 0) {
+			if (sscanf(line.c_str(), " x = %d , y = %d", &width, &height) != 2 || width <= 0 || height <= 0
+				|| int64_t(width) * height > MAX_PATTERN_CELLS) {
+				return false;
+			}
+			continue;
+		}
+		body += line;
+	}
+	if (width < 0) {
+		return false;
+	}
+
+	pattern->width = width;
+	pattern->height = height;
+	pattern->cells.assign(size_t(width) * height, 0);
+	int x = 0;
+	int y = 0;
+	int count = 0;
+	for (char c : body) {
+		if (isdigit((unsigned char)c)) {
+			count = count * 10 + (c - '0');
+			if (count > MAX_PATTERN_CELLS) {
+				return false;
+			}
+			continue;
+		}
+		if (isspace((unsigned char)c)) {
+			continue;
+		}
+		int run = count ? count : 1;
+		count = 0;
+		if (c == '!') {
+			break;
+		}
+		if (c == '$') {
+			y += run;
+			x = 0;
+			continue;
+		}
+		int state;
+		if (c == 'b' || c == '.') {
+			state = 0;
+		} else if (c == 'o') {
+			state = 1;
+		} else if (c >= 'A' && c <= 'X') {
+			state = c - 'A' + 1;
+		} else {
+			return false;
+		}
+		if (x + run > width || (state && y >= height)) {
+			return false;
+		}
+		if (state) {
+			std::fill_n(pattern->cells.begin() + size_t(y) * width + x, run, uint8_t(state));
+		}
+		x += run;
+	}
+	return true;
+}
+
+bool read_rle(const std::string& path, Pattern* pattern) {
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+	return parse_rle(text.str(), pattern);
+}
+
+Pattern brush_pattern(int radius) {
+	Pattern brush;
+	brush.width = 2 * radius + 1;
+	brush.height = brush.width;
+	brush.cells.assign(size_t(brush.width) * brush.height, 0);
+	for (int dy = -radius; dy <= radius; dy++) {
+		for (int dx = -radius; dx <= radius; dx++) {
+			// r^2 + r rounds the disc out, a radius 1 brush is a plus
+			if (dx * dx + dy * dy <= radius * radius + radius) {
+				brush.cells[(dy + radius) * brush.width + dx + radius] = 1;
+			}
+		}
+	}
+	return brush;
+}
+
+void pattern_cells(const Pattern& pattern, int species, int board_species, bool transparent, uint64_t* cells) {
+	for (int y = 0; y < pattern.height; y++) {
+		const uint8_t* row = pattern.cells.data() + size_t(pattern.height - 1 - y) * pattern.width;
+		uint64_t* out = cells + size_t(y) * pattern.width;
+		for (int x = 0; x < pattern.width; x++) {
+			int state = row[x];
+			if (!state) {
+				out[x] = transparent ? EDIT_KEEP : 0;
+			} else if (species == 0) {
+				out[x] = 0;
+			} else {
+				int cell_species = (species - 1 + state - 1) % board_species + 1;
+				out[x] = 1ULL << ((cell_species - 1) * 4);
+			}
+		}
+	}
+}
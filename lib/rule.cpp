@@ -0,0 +1,55 @@
+#include "rule.h"
+#include <cctype>
+
+// Accepts "B3/S23", "b36/s23" and the older "23/3" survival/birth form
+bool parse_rule(const std::string& text, Rule* rule) {
+	Rule parsed = { 0, 0 };
+	uint16_t* current = nullptr;
+	bool seen_birth = false;
+	bool seen_survive = false;
+	bool legacy = text.find_first_of("bBsS") == std::string::npos;
+	if (legacy) {
+		current = &parsed.survive;
+		seen_survive = true;
+	}
+
+	for (char c : text) {
+		if (c == 'B' || c == 'b') {
+			if (seen_birth) return false;
+			current = &parsed.birth;
+			seen_birth = true;
+		} else if (c == 'S' || c == 's') {
+			if (seen_survive) return false;
+			current = &parsed.survive;
+			seen_survive = true;
+		} else if (c == '/') {
+			if (legacy) {
+				if (seen_birth) return false;
+				current = &parsed.birth;
+				seen_birth = true;
+			}
+		} else if (c >= '0' && c <= '8' && current) {
+			*current |= 1 << (c - '0');
+		} else {
+			return false;
+		}
+	}
+
+	if (!seen_birth || !seen_survive || (parsed.birth & 1)) {
+		return false;
+	}
+	*rule = parsed;
+	return true;
+}
+
+std::string rule_string(Rule rule) {
+	std::string text = "B";
+	for (int n = 0; n <= 8; n++) {
+		if (rule.birth & (1 << n)) text += char('0' + n);
+	}
+	text += "/S";
+	for (int n = 0; n <= 8; n++) {
+		if (rule.survive & (1 << n)) text += char('0' + n);
+	}
+	return text;
+}
@@ -0,0 +1,644 @@
+#include "simulation.h"
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include "oneapi/tbb/blocked_range.h"
+#include "oneapi/tbb/combinable.h"
+#include "oneapi/tbb/parallel_reduce.h"
+#include "kernels.h"
+
+using namespace oneapi;
+
+bool parse_backend(const std::string& text, Backend* backend) {
+	if (text == "opencl" || text == "gpu") {
+		*backend = Backend::OpenCL;
+		return true;
+	}
+	if (text == "cpu" || text == "tbb") {
+		*backend = Backend::CPU;
+		return true;
+	}
+	return false;
+}
+
+const char* backend_name(Backend backend) {
+	switch (backend) {
+		case Backend::OpenCL:
+			return "opencl";
+		case Backend::CPU:
+			return "cpu";
+	}
+	return "unknown";
+}
+
+Simulation::Simulation(
+        Grid* grid,
+        Rule rule,
+        const SimulationSettings& settings,
+        const cl_context_properties* properties
+    )
+{
+	m_grid = grid;
+	m_next = nullptr;
+	m_rule = rule;
+	m_settings = settings;
+	m_backend = settings.backend;
+	m_stepper = nullptr;
+	m_inPlace = nullptr;
+	m_ctx = nullptr;
+	m_program = nullptr;
+	m_frameKernel = nullptr;
+	m_saveKernel = nullptr;
+	m_inPlaceKernel = nullptr;
+	m_outBuffer = nullptr;
+	m_borderBuffer = nullptr;
+	m_counts = SpeciesCounts{};
+	m_levelBuffer = nullptr;
+	m_levelCapacity = 0;
+	m_pending = false;
+	m_localSize = 0;
+	m_hash = board_hash(grid);
+	m_cycles.push(m_hash, false);
+
+	m_generation = 0;
+
+	if (m_backend == Backend::CPU) {
+		bool specialized;
+		if (settings.in_place) {
+			m_inPlace = new CpuStepper(grid->species, rule);
+			specialized = m_inPlace->specialized();
+		} else {
+			m_next = grid_init(grid->width, grid->height, grid->species);
+			clear(m_next);
+			m_stepper = new FrontierStepper(grid->species, rule, grid->width, grid->height);
+			specialized = m_stepper->specialized();
+		}
+		if (!specialized) {
+			std::cout << "No specialised stepper for " << rule_string(rule) << ", using runtime masks\n";
+		}
+		return;
+	}
+	setupPlatform(properties);
+	setupKernels();
+	if (m_program) {
+		setupBuffers();
+	}
+}
+
+Simulation::~Simulation() {
+	if (m_backend == Backend::OpenCL && m_program) {
+		clFinish(m_queue);
+		cl_mem buffers[] = { m_inBuffer, m_outBuffer, m_totalVertices, m_hashBuffer, m_tieBuffer, m_dirtyBuffer, m_countsBuffer, m_borderBuffer, m_levelBuffer };
+		for (cl_mem buffer : buffers) {
+			if (buffer) {
+				clReleaseMemObject(buffer);
+			}
+		}
+		clReleaseKernel(m_gameKernel);
+		clReleaseKernel(m_countKernel);
+		clReleaseKernel(m_levelKernel);
+		cl_kernel optional[] = { m_frameKernel, m_saveKernel, m_inPlaceKernel };
+		for (cl_kernel kernel : optional) {
+			if (kernel) {
+				clReleaseKernel(kernel);
+			}
+		}
+		clReleaseCommandQueue(m_queue);
+		clReleaseProgram(m_program);
+		clReleaseContext(m_ctx);
+	}
+	delete m_stepper;
+	delete m_inPlace;
+	grid_free(m_grid);
+	if (m_next) {
+		grid_free(m_next);
+	}
+}
+
+bool Simulation::ok() const {
+	return m_backend == Backend::CPU || m_program;
+}
+
+void Simulation::setupPlatform(const cl_context_properties* properties) {
+	cl_int err;
+	m_device = select_device(m_settings.device);
+	m_ctx = clCreateContext(properties, 1, &m_device, nullptr, nullptr, &err);
+}
+
+// Most work items a group of the kernel can have on the device, 0 if it can't be asked
+static size_t group_limit(cl_kernel kernel, cl_device_id device) {
+	size_t groupSize = 0;
+	if (!kernel || clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE, sizeof(groupSize), &groupSize, nullptr) != CL_SUCCESS) {
+		return 0;
+	}
+	return groupSize;
+}
+
+void Simulation::setupKernels() {
+	cl_int err;
+
+	m_program = build_program(m_ctx, m_device, kernel_source(), kernel_options(m_grid, m_rule, m_settings.validate), m_settings.kernel_cache);
+	if (!m_program) {
+		std::cerr << "Build failed, aborting\n";
+		clReleaseContext(m_ctx);
+		return;
+	}
+
+	m_queue = clCreateCommandQueue(m_ctx, m_device, 0, &err);
+
+	m_gameKernel = clCreateKernel(m_program, "gameOfLife", &err);
+	m_countKernel = clCreateKernel(m_program, "countCells", &err);
+	m_levelKernel = clCreateKernel(m_program, "reduceLevel", &err);
+
+	if (m_settings.fused) {
+		m_frameKernel = clCreateKernel(m_program, "stepFrame", &err);
+		if (err != CL_SUCCESS || group_limit(m_frameKernel, m_device) < size_t(FRAME_TILE * FRAME_TILE)) {
+			std::cout << "Device can't run " << FRAME_TILE << "x" << FRAME_TILE << " work groups, frames take separate passes\n";
+			if (m_frameKernel) {
+				clReleaseKernel(m_frameKernel);
+			}
+			m_frameKernel = nullptr;
+		}
+	}
+
+	// The tuned size has to fit every kernel the frame may launch
+	size_t groupSize = std::min(group_limit(m_gameKernel, m_device), group_limit(m_countKernel, m_device));
+	if (m_frameKernel) {
+		groupSize = std::min(groupSize, group_limit(m_frameKernel, m_device));
+	}
+	m_localSize = m_settings.local_size;
+	if (m_localSize > groupSize) {
+		std::cout << "Device can't run " << m_localSize << " work items per group, leaving it to the driver\n";
+		m_localSize = 0;
+	}
+
+	if (m_settings.in_place) {
+		m_saveKernel = clCreateKernel(m_program, "saveBorders", &err);
+		if (err == CL_SUCCESS) {
+			m_inPlaceKernel = clCreateKernel(m_program, "stepInPlace", &err);
+		}
+		if (err != CL_SUCCESS || group_limit(m_inPlaceKernel, m_device) < size_t(IN_PLACE_TILE * IN_PLACE_TILE / IN_PLACE_ROWS)) {
+			std::cout << "Device can't step in place, using two buffers\n";
+			m_settings.in_place = false;
+		}
+	}
+}
+
+void Simulation::setupBuffers() {
+	cl_int err;
+	size_t gridBytes = size(m_grid) * sizeof(uint64_t);
+	m_inBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+				gridBytes, m_grid->arr, &err);
+	if (m_settings.in_place) {
+		int tiles = ((m_grid->width + IN_PLACE_TILE - 1) / IN_PLACE_TILE) * ((m_grid->height + IN_PLACE_TILE - 1) / IN_PLACE_TILE);
+		m_borderBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE, size_t(tiles) * 4 * IN_PLACE_TILE * sizeof(uint64_t), nullptr, &err);
+	} else {
+		// Only the padding has to start out empty, the rest is written every step
+		m_outBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE, gridBytes, nullptr, &err);
+		uint64_t empty = 0;
+		clEnqueueFillBuffer(m_queue, m_outBuffer, &empty, sizeof(empty), 0, gridBytes, 0, nullptr, nullptr);
+	}
+
+	m_totalVertices = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE, sizeof(cl_uint), nullptr, &err);
+
+	// The kernel XORs its changes into the hash, so it starts at the board's
+	m_hashHalves[0] = cl_uint(m_hash);
+	m_hashHalves[1] = cl_uint(m_hash >> 32);
+	m_hashBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(m_hashHalves), m_hashHalves, &err);
+	m_tieBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE, sizeof(cl_uint), nullptr, &err);
+
+	m_tilesX = (m_grid->width + SYNC_TILE - 1) / SYNC_TILE;
+	m_tilesY = (m_grid->height + SYNC_TILE - 1) / SYNC_TILE;
+	m_dirty.assign((m_tilesX * m_tilesY + 31) / 32, 0);
+	m_dirtyBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, m_dirty.size() * sizeof(cl_uint), m_dirty.data(), &err);
+	m_countsBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE, (m_grid->species + 1) * sizeof(cl_uint), nullptr, &err);
+}
+
+void Simulation::step() {
+	applyEdits();
+	uint64_t seed = generation_seed(m_settings.seed, m_generation++);
+	if (m_backend == Backend::CPU) {
+		int band = m_settings.band;
+		StepStats stats = m_inPlace
+			? m_inPlace->stepInPlace(m_grid, seed, band ? band : IN_PLACE_BAND)
+			: m_stepper->step(m_grid, m_next, seed, nullptr, band ? band : 1);
+		swap();
+		record(m_hash ^ stats.hash, stats.ties);
+		return;
+	}
+	if (m_pending) {
+		finish();
+	}
+
+	const size_t* localWorkSize;
+	size_t globalWorkSize = launchSize(size_t(m_grid->width) * m_grid->height, &localWorkSize);
+	cl_uint zero = 0;
+	clEnqueueFillBuffer(m_queue, m_tieBuffer, &zero, sizeof(cl_uint), 0, sizeof(cl_uint), 0, nullptr, nullptr);
+	if (m_settings.in_place) {
+		stepInPlace(seed);
+		return;
+	}
+	clSetKernelArg(m_gameKernel, 0, sizeof(cl_mem), &m_inBuffer);
+	clSetKernelArg(m_gameKernel, 1, sizeof(cl_mem), &m_outBuffer);
+	clSetKernelArg(m_gameKernel, 2, sizeof(uint64_t), &seed);
+	clSetKernelArg(m_gameKernel, 3, sizeof(cl_mem), &m_hashBuffer);
+	clSetKernelArg(m_gameKernel, 4, sizeof(cl_mem), &m_tieBuffer);
+	clSetKernelArg(m_gameKernel, 5, sizeof(cl_mem), &m_dirtyBuffer);
+
+	clEnqueueNDRangeKernel(m_queue, m_gameKernel, 1, nullptr, &globalWorkSize, localWorkSize, 0, nullptr, nullptr);
+	clEnqueueReadBuffer(m_queue, m_hashBuffer, CL_FALSE, 0, sizeof(m_hashHalves), m_hashHalves, 0, nullptr, nullptr);
+	clEnqueueReadBuffer(m_queue, m_tieBuffer, CL_FALSE, 0, sizeof(cl_uint), &m_ties, 0, nullptr, nullptr);
+	m_pending = true;
+	swap();
+}
+
+void Simulation::stepInPlace(uint64_t seed) {
+	size_t tilesX = (m_grid->width + IN_PLACE_TILE - 1) / IN_PLACE_TILE;
+	size_t tilesY = (m_grid->height + IN_PLACE_TILE - 1) / IN_PLACE_TILE;
+	size_t borderWorkSize = tilesX * tilesY * IN_PLACE_TILE;
+	clSetKernelArg(m_saveKernel, 0, sizeof(cl_mem), &m_inBuffer);
+	clSetKernelArg(m_saveKernel, 1, sizeof(cl_mem), &m_borderBuffer);
+	clEnqueueNDRangeKernel(m_queue, m_saveKernel, 1, nullptr, &borderWorkSize, nullptr, 0, nullptr, nullptr);
+
+	clSetKernelArg(m_inPlaceKernel, 0, sizeof(cl_mem), &m_inBuffer);
+	clSetKernelArg(m_inPlaceKernel, 1, sizeof(cl_mem), &m_borderBuffer);
+	clSetKernelArg(m_inPlaceKernel, 2, sizeof(uint64_t), &seed);
+	clSetKernelArg(m_inPlaceKernel, 3, sizeof(cl_mem), &m_hashBuffer);
+	clSetKernelArg(m_inPlaceKernel, 4, sizeof(cl_mem), &m_tieBuffer);
+	clSetKernelArg(m_inPlaceKernel, 5, sizeof(cl_mem), &m_dirtyBuffer);
+	size_t localWorkSize[2] = { IN_PLACE_TILE, IN_PLACE_TILE / IN_PLACE_ROWS };
+	size_t globalWorkSize[2] = { tilesX * localWorkSize[0], tilesY * localWorkSize[1] };
+	clEnqueueNDRangeKernel(m_queue, m_inPlaceKernel, 2, nullptr, globalWorkSize, localWorkSize, 0, nullptr, nullptr);
+
+	clEnqueueReadBuffer(m_queue, m_hashBuffer, CL_FALSE, 0, sizeof(m_hashHalves), m_hashHalves, 0, nullptr, nullptr);
+	clEnqueueReadBuffer(m_queue, m_tieBuffer, CL_FALSE, 0, sizeof(cl_uint), &m_ties, 0, nullptr, nullptr);
+	m_pending = true;
+}
+
+cl_uint Simulation::frame(const Region& region, cl_uchar* levels) {
+	applyEdits();
+	if (m_backend == Backend::CPU) {
+		uint64_t seed = generation_seed(m_settings.seed, m_generation++);
+		tbb::combinable<SpeciesCounts> counts([] { return SpeciesCounts{}; });
+		const Grid* grid = m_grid;
+		bool validate = m_settings.validate;
+		// Bands are whole rows of points, so every point is reduced in one band
+		RowObserver observe = [grid, &region, levels, &counts, validate](int y_begin, int y_end) {
+			count_species(grid, y_begin, y_end, validate, &counts.local());
+			int row_begin = std::max(0, (y_begin - region.y + region.step - 1) / region.step);
+			int row_end = std::min(region.rows, (y_end - region.y + region.step - 1) / region.step);
+			reduce_level_rows(grid, region, row_begin, row_end, levels);
+		};
+		int band = m_settings.band;
+		StepStats stats = m_inPlace
+			? m_inPlace->stepInPlace(m_grid, seed, std::max(region.step, band ? band : IN_PLACE_BAND), observe)
+			: m_stepper->step(m_grid, m_next, seed, observe, std::max(region.step, band ? band : FRAME_TILE));
+		m_counts = counts.combine([](const SpeciesCounts& a, const SpeciesCounts& b) { return a + b; });
+		swap();
+		record(m_hash ^ stats.hash, stats.ties);
+		report(nullptr);
+		return m_counts.population;
+	}
+	// The fused kernel writes a second buffer
+	if (!m_frameKernel || m_settings.in_place) {
+		cl_uint population = count();
+		reduce(region, levels);
+		step();
+		return population;
+	}
+	if (m_pending) {
+		finish();
+	}
+	// Too far out for a point to fit in one work group
+	if (region.step > FRAME_TILE) {
+		reduce(region, levels);
+	}
+	reserveLevels(region.cols * region.rows);
+
+	uint64_t seed = generation_seed(m_settings.seed, m_generation++);
+	cl_uint zero = 0;
+	clEnqueueFillBuffer(m_queue, m_tieBuffer, &zero, sizeof(cl_uint), 0, sizeof(cl_uint), 0, nullptr, nullptr);
+	clEnqueueFillBuffer(m_queue, m_countsBuffer, &zero, sizeof(cl_uint), 0, (m_grid->species + 1) * sizeof(cl_uint), 0, nullptr, nullptr);
+	clSetKernelArg(m_frameKernel, 0, sizeof(cl_mem), &m_inBuffer);
+	clSetKernelArg(m_frameKernel, 1, sizeof(cl_mem), &m_outBuffer);
+	clSetKernelArg(m_frameKernel, 2, sizeof(uint64_t), &seed);
+	clSetKernelArg(m_frameKernel, 3, sizeof(cl_mem), &m_hashBuffer);
+	clSetKernelArg(m_frameKernel, 4, sizeof(cl_mem), &m_tieBuffer);
+	clSetKernelArg(m_frameKernel, 5, sizeof(cl_mem), &m_dirtyBuffer);
+	clSetKernelArg(m_frameKernel, 6, sizeof(cl_mem), &m_levelBuffer);
+	clSetKernelArg(m_frameKernel, 7, sizeof(int), &region.x);
+	clSetKernelArg(m_frameKernel, 8, sizeof(int), &region.y);
+	clSetKernelArg(m_frameKernel, 9, sizeof(int), &region.step);
+	clSetKernelArg(m_frameKernel, 10, sizeof(int), &region.cols);
+	clSetKernelArg(m_frameKernel, 11, sizeof(int), &region.rows);
+	clSetKernelArg(m_frameKernel, 12, sizeof(cl_mem), &m_countsBuffer);
+
+	size_t localWorkSize[2] = { FRAME_TILE, FRAME_TILE };
+	size_t globalWorkSize[2] = {
+		size_t(m_grid->width + FRAME_TILE - 1) / FRAME_TILE * FRAME_TILE,
+		size_t(m_grid->height + FRAME_TILE - 1) / FRAME_TILE * FRAME_TILE
+	};
+	clEnqueueNDRangeKernel(m_queue, m_frameKernel, 2, nullptr, globalWorkSize, localWorkSize, 0, nullptr, nullptr);
+	if (region.step <= FRAME_TILE) {
+		clEnqueueReadBuffer(m_queue, m_levelBuffer, CL_FALSE, 0, region.cols * region.rows * 2, levels, 0, nullptr, nullptr);
+	}
+	clEnqueueReadBuffer(m_queue, m_hashBuffer, CL_FALSE, 0, sizeof(m_hashHalves), m_hashHalves, 0, nullptr, nullptr);
+	clEnqueueReadBuffer(m_queue, m_tieBuffer, CL_FALSE, 0, sizeof(cl_uint), &m_ties, 0, nullptr, nullptr);
+	cl_uint counts[17];
+	clEnqueueReadBuffer(m_queue, m_countsBuffer, CL_TRUE, 0, (m_grid->species + 1) * sizeof(cl_uint), counts, 0, nullptr, nullptr);
+	m_pending = true;
+	swap();
+	report(counts);
+	return m_counts.population;
+}
+
+// Takes the device's counts, then warns about cells validation caught
+void Simulation::report(const cl_uint* counts) {
+	if (counts) {
+		m_counts = SpeciesCounts{};
+		for (int s = 0; s < m_grid->species; s++) {
+			m_counts.species[s] = counts[s];
+			m_counts.population += counts[s];
+		}
+		m_counts.invalid = counts[m_grid->species];
+	}
+	if (m_counts.invalid) {
+		std::cerr << m_counts.invalid << " cells hold more than one species at generation " << m_generation - 1 << "\n";
+	}
+}
+
+cl_uint Simulation::count() {
+	if (m_backend == Backend::CPU) {
+		Grid* grid = m_grid;
+		return tbb::parallel_reduce(tbb::blocked_range<int>(0, grid->height), 0u,
+			[grid](const tbb::blocked_range<int>& r, cl_uint total) {
+				for (int y = r.begin(); y < r.end(); y++) {
+					const uint64_t* row = grid->arr + (y+1) * (grid->width+2) + 1;
+					for (int x = 0; x < grid->width; x++) {
+						total += row[x] != 0;
+					}
+				}
+				return total;
+			},
+			[](cl_uint a, cl_uint b) { return a + b; }
+		);
+	}
+
+	const size_t* localWorkSize;
+	size_t globalWorkSize = launchSize(size_t(m_grid->width) * m_grid->height, &localWorkSize);
+	cl_uint zero = 0;
+	cl_uint vertexCount;
+	clEnqueueWriteBuffer(m_queue, m_totalVertices, CL_TRUE, 0, sizeof(cl_uint), &zero, 0, NULL, NULL);
+
+	clSetKernelArg(m_countKernel, 0, sizeof(cl_mem), &m_inBuffer);
+	clSetKernelArg(m_countKernel, 1, sizeof(cl_mem), &m_totalVertices);
+
+	clEnqueueNDRangeKernel(m_queue, m_countKernel, 1, nullptr, &globalWorkSize, localWorkSize, 0, nullptr, nullptr);
+	clEnqueueReadBuffer(m_queue, m_totalVertices, CL_TRUE, 0, sizeof(cl_uint), &vertexCount, 0, nullptr, nullptr);
+	return vertexCount;
+}
+
+void Simulation::reduce(const Region& region, cl_uchar* levels) {
+	if (m_backend == Backend::CPU) {
+		reduce_level(m_grid, region, levels);
+		return;
+	}
+
+	size_t levelWorkSize = region.cols * region.rows;
+	reserveLevels(levelWorkSize);
+
+	clSetKernelArg(m_levelKernel, 0, sizeof(cl_mem), &m_inBuffer);
+	clSetKernelArg(m_levelKernel, 1, sizeof(cl_mem), &m_levelBuffer);
+	clSetKernelArg(m_levelKernel, 2, sizeof(int), &region.x);
+	clSetKernelArg(m_levelKernel, 3, sizeof(int), &region.y);
+	clSetKernelArg(m_levelKernel, 4, sizeof(int), &region.step);
+	clSetKernelArg(m_levelKernel, 5, sizeof(int), &region.cols);
+
+	clEnqueueNDRangeKernel(m_queue, m_levelKernel, 1, nullptr, &levelWorkSize, nullptr, 0, nullptr, nullptr);
+
+	// Only the reduced level comes back to the host, never the whole board
+	clEnqueueReadBuffer(m_queue, m_levelBuffer, CL_TRUE, 0, levelWorkSize * 2, levels, 0, nullptr, nullptr);
+}
+
+// Global size of a per cell kernel, padded to whole groups of the tuned local size
+size_t Simulation::launchSize(size_t cells, const size_t** local) const {
+	*local = m_localSize ? &m_localSize : nullptr;
+	return m_localSize ? (cells + m_localSize - 1) / m_localSize * m_localSize : cells;
+}
+
+void Simulation::reserveLevels(size_t points) {
+	if (points <= (size_t)m_levelCapacity) {
+		return;
+	}
+	cl_int err;
+	if (m_levelBuffer) {
+		clReleaseMemObject(m_levelBuffer);
+	}
+	m_levelCapacity = points;
+	m_levelBuffer = clCreateBuffer(m_ctx, CL_MEM_READ_WRITE, m_levelCapacity * 2, nullptr, &err);
+}
+
+size_t Simulation::sync() {
+	if (m_backend == Backend::CPU) {
+		return 0;
+	}
+
+	// Tiles stay marked across generations until they're fetched
+	clEnqueueReadBuffer(m_queue, m_dirtyBuffer, CL_TRUE, 0, m_dirty.size() * sizeof(cl_uint), m_dirty.data(), 0, nullptr, nullptr);
+	cl_uint zero = 0;
+	clEnqueueFillBuffer(m_queue, m_dirtyBuffer, &zero, sizeof(cl_uint), 0, m_dirty.size() * sizeof(cl_uint), 0, nullptr, nullptr);
+
+	auto dirty = [this](int tx, int ty) {
+		int tile = ty * m_tilesX + tx;
+		return (m_dirty[tile / 32] >> (tile % 32)) & 1u;
+	};
+	size_t rowPitch = (m_grid->width + 2) * sizeof(uint64_t);
+	size_t bytes = 0;
+	for (int ty = 0; ty < m_tilesY; ty++) {
+		int tx = 0;
+		while (tx < m_tilesX) {
+			if (!dirty(tx, ty)) {
+				tx++;
+				continue;
+			}
+			// One rectangle for a run of dirty tiles along the row
+			int run = tx;
+			while (run < m_tilesX && dirty(run, ty)) {
+				run++;
+			}
+			int x0 = tx * SYNC_TILE;
+			int y0 = ty * SYNC_TILE;
+			int cols = std::min(run * SYNC_TILE, m_grid->width) - x0;
+			int rows = std::min(y0 + SYNC_TILE, m_grid->height) - y0;
+			size_t origin[3] = { (x0 + 1) * sizeof(uint64_t), size_t(y0 + 1), 0 };
+			size_t region[3] = { cols * sizeof(uint64_t), size_t(rows), 1 };
+			clEnqueueReadBufferRect(m_queue, m_inBuffer, CL_FALSE, origin, origin, region,
+				rowPitch, 0, rowPitch, 0, m_grid->arr, 0, nullptr, nullptr);
+			bytes += region[0] * rows;
+			tx = run;
+		}
+	}
+	clFinish(m_queue);
+	return bytes;
+}
+
+void Simulation::read(uint64_t* cells) {
+	sync();
+	memcpy(cells, m_grid->arr, size(m_grid) * sizeof(uint64_t));
+}
+
+void Simulation::load(const uint64_t* cells, uint64_t generation) {
+	finish();
+	if (cells != m_grid->arr) {
+		memcpy(m_grid->arr, cells, size(m_grid) * sizeof(uint64_t));
+	}
+	m_generation = generation;
+	m_hash = board_hash(m_grid);
+	m_cycles.reset();
+	m_cycles.push(m_hash, false);
+	if (m_backend == Backend::CPU) {
+		if (m_stepper) {
+			m_stepper->invalidate();
+		}
+		return;
+	}
+	m_hashHalves[0] = cl_uint(m_hash);
+	m_hashHalves[1] = cl_uint(m_hash >> 32);
+	clEnqueueWriteBuffer(m_queue, m_inBuffer, CL_FALSE, 0, size(m_grid) * sizeof(uint64_t), m_grid->arr, 0, nullptr, nullptr);
+	clEnqueueWriteBuffer(m_queue, m_hashBuffer, CL_TRUE, 0, sizeof(m_hashHalves), m_hashHalves, 0, nullptr, nullptr);
+}
+
+void Simulation::edit(int x, int y, int width, int height, const uint64_t* cells) {
+	int x0 = std::max(x, 0);
+	int y0 = std::max(y, 0);
+	int x1 = std::min(x + width, m_grid->width);
+	int y1 = std::min(y + height, m_grid->height);
+	if (x0 >= x1 || y0 >= y1) {
+		return;
+	}
+	Edit edit = { x0, y0, x1 - x0, y1 - y0, SIZE_MAX };
+	if (cells) {
+		edit.offset = m_editCells.size();
+		for (int row = y0; row < y1; row++) {
+			const uint64_t* source = cells + size_t(row - y) * width + (x0 - x);
+			m_editCells.insert(m_editCells.end(), source, source + edit.width);
+		}
+	}
+	m_edits.push_back(edit);
+}
+
+/* Edits land on the host grid in order, so overlapping ones stack up and
+ * the hash sees every change. A device's rectangles are read into the
+ * mirror first for the cells they replace, then written back from it. */
+void Simulation::applyEdits() {
+	if (m_edits.empty()) {
+		return;
+	}
+	finish();
+	size_t rowPitch = (m_grid->width + 2) * sizeof(uint64_t);
+	if (m_backend == Backend::OpenCL) {
+		for (const Edit& edit : m_edits) {
+			size_t origin[3] = { (edit.x + 1) * sizeof(uint64_t), size_t(edit.y + 1), 0 };
+			size_t region[3] = { edit.width * sizeof(uint64_t), size_t(edit.height), 1 };
+			clEnqueueReadBufferRect(m_queue, m_inBuffer, CL_FALSE, origin, origin, region,
+				rowPitch, 0, rowPitch, 0, m_grid->arr, 0, nullptr, nullptr);
+		}
+		clFinish(m_queue);
+	}
+
+	uint64_t hash = 0;
+	for (const Edit& edit : m_edits) {
+		int64_t population = 0;
+		for (int y = 0; y < edit.height; y++) {
+			uint64_t* row = m_grid->arr + size_t(edit.y + y + 1) * (m_grid->width + 2) + edit.x + 1;
+			const uint64_t* cells = edit.offset == SIZE_MAX ? nullptr : m_editCells.data() + edit.offset + size_t(y) * edit.width;
+			uint64_t gid = uint64_t(edit.y + y) * m_grid->width + edit.x;
+			for (int x = 0; x < edit.width; x++) {
+				uint64_t value = cells ? cells[x] : 0;
+				if (value == EDIT_KEEP || value == row[x]) {
+					continue;
+				}
+				hash ^= zobrist(gid + x, row[x]) ^ zobrist(gid + x, value);
+				population += int64_t(value != 0) - int64_t(row[x] != 0);
+				row[x] = value;
+			}
+		}
+		if (m_backend == Backend::OpenCL) {
+			size_t origin[3] = { (edit.x + 1) * sizeof(uint64_t), size_t(edit.y + 1), 0 };
+			size_t region[3] = { edit.width * sizeof(uint64_t), size_t(edit.height), 1 };
+			clEnqueueWriteBufferRect(m_queue, m_inBuffer, CL_FALSE, origin, origin, region,
+				rowPitch, 0, rowPitch, 0, m_grid->arr, 0, nullptr, nullptr);
+		} else if (m_stepper) {
+			m_stepper->edit(edit.x, edit.y, edit.width, edit.height, population);
+		}
+	}
+	m_edits.clear();
+	m_editCells.clear();
+
+	// Drawn by hand, so whatever cycle the board was in is over
+	m_hash ^= hash;
+	m_cycles.reset();
+	m_cycles.push(m_hash, false);
+	if (m_backend == Backend::OpenCL) {
+		m_hashHalves[0] = cl_uint(m_hash);
+		m_hashHalves[1] = cl_uint(m_hash >> 32);
+		clEnqueueWriteBuffer(m_queue, m_hashBuffer, CL_TRUE, 0, sizeof(m_hashHalves), m_hashHalves, 0, nullptr, nullptr);
+	}
+}
+
+void Simulation::finish() {
+	if (m_backend == Backend::OpenCL) {
+		clFinish(m_queue);
+	}
+	if (m_pending) {
+		m_pending = false;
+		record(uint64_t(m_hashHalves[1]) << 32 | m_hashHalves[0], m_ties);
+	}
+}
+
+void Simulation::record(uint64_t hash, uint64_t ties) {
+	m_hash = hash;
+	m_cycles.push(hash, ties > 0);
+}
+
+Grid* Simulation::grid() {
+	return m_grid;
+}
+
+uint64_t Simulation::hash() const {
+	return m_hash;
+}
+
+uint64_t Simulation::generation() const {
+	return m_generation;
+}
+
+const SpeciesCounts& Simulation::counts() const {
+	return m_counts;
+}
+
+const CycleDetector& Simulation::cycles() const {
+	return m_cycles;
+}
+
+Backend Simulation::backend() const {
+	return m_backend;
+}
+
+cl_context Simulation::context() const {
+	return m_ctx;
+}
+
+void Simulation::swap() {
+	if (m_settings.in_place) {
+		return;
+	}
+	if (m_backend == Backend::CPU) {
+		std::swap(m_grid, m_next);
+		return;
+	}
+	// The host grid stays put as the mirror sync() patches
+	std::swap(m_inBuffer, m_outBuffer);
+}
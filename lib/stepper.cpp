@@ -0,0 +1,117 @@
+#include "stepper.h"
+#include <utility>
+#include "oneapi/tbb/blocked_range.h"
+#include "oneapi/tbb/parallel_for.h"
+#include "oneapi/tbb/parallel_reduce.h"
+
+using namespace oneapi;
+
+const int MAX_STEPPER_SPECIES = 16;
+
+typedef StaticRule<1 << 3, 1 << 2 | 1 << 3> Conway;                       // B3/S23
+typedef StaticRule<1 << 3 | 1 << 6, 1 << 2 | 1 << 3> HighLife;            // B36/S23
+typedef StaticRule<1 << 2, 0> Seeds;                                      // B2/S
+typedef StaticRule<0x1C8, 0x1D8> DayAndNight;                             // B3678/S34678
+typedef StaticRule<1 << 3, 0x1FF> LifeWithoutDeath;                       // B3/S012345678
+typedef StaticRule<1 << 3, 0x3E> Maze;                                    // B3/S12345
+typedef StaticRule<1 << 3 | 1 << 6, 1 << 1 | 1 << 2 | 1 << 5> TwoByTwo;   // B36/S125
+typedef StaticRule<0x1E8, 0x1E0> Diamoeba;                                // B35678/S5678
+typedef StaticRule<1 << 3 | 1 << 6 | 1 << 8, 1 << 2 | 1 << 4 | 1 << 5> Morley; // B368/S245
+
+typedef struct {
+	StepFunction rows;
+	CellFunction cells;
+	InPlaceFunction in_place;
+} StepFunctions;
+
+template <class R, int... S>
+static const StepFunctions* lookup(int species, std::integer_sequence<int, S...>) {
+	static const StepFunctions table[] = { { &step_rows<S + 1, R>, &step_cells<S + 1, R>, &step_rows_in_place<S + 1, R> }... };
+	return &table[species - 1];
+}
+
+template <class R>
+static const StepFunctions* lookup(int species) {
+	return lookup<R>(species, std::make_integer_sequence<int, MAX_STEPPER_SPECIES>());
+}
+
+template <class R>
+static bool matches(Rule rule) {
+	return R::birth == rule.birth && R::survive == rule.survive;
+}
+
+template <class... Rules>
+static const StepFunctions* select(int species, Rule rule) {
+	const StepFunctions* found = nullptr;
+	((found == nullptr && matches<Rules>(rule) ? (found = lookup<Rules>(species)) : found), ...);
+	return found;
+}
+
+CpuStepper::CpuStepper(int species, Rule rule) {
+	m_rule = rule;
+	const StepFunctions* functions = select<Conway, HighLife, Seeds, DayAndNight, LifeWithoutDeath, Maze, TwoByTwo, Diamoeba, Morley>(species, rule);
+	m_specialized = functions != nullptr;
+	if (!m_specialized) {
+		functions = lookup<DynamicRule>(species);
+	}
+	m_step = functions->rows;
+	m_cells = functions->cells;
+	m_inPlace = functions->in_place;
+}
+
+StepStats CpuStepper::step(const Grid* in, Grid* out, uint64_t seed, int row_offset, int grain) {
+	return tbb::parallel_reduce(tbb::blocked_range<int>(0, in->height, std::max(grain, 1)), StepStats{ 0, 0, 0, 0 },
+		[this, in, out, seed, row_offset](const tbb::blocked_range<int>& r, StepStats stats) {
+			return stats + m_step(in, out, r.begin(), r.end(), seed, m_rule, row_offset);
+		},
+		[](StepStats a, StepStats b) {
+			return a + b;
+		}
+	);
+}
+
+StepStats CpuStepper::stepRows(const Grid* in, Grid* out, int y_begin, int y_end, uint64_t seed, int row_offset) {
+	return m_step(in, out, y_begin, y_end, seed, m_rule, row_offset);
+}
+
+StepStats CpuStepper::stepCells(const Grid* in, Grid* out, const uint32_t* cells, size_t count, uint64_t seed, std::vector<uint32_t>* changed) {
+	return m_cells(in, out, cells, count, seed, m_rule, changed);
+}
+
+StepStats CpuStepper::stepInPlace(Grid* grid, uint64_t seed, int band, const RowObserver& observe) {
+	int height = grid->height;
+	int bands = (height + band - 1) / band;
+	size_t dx = grid->width + 2;
+	m_halos.resize(bands * 2 * dx);
+	tbb::parallel_for(0, bands, [this, grid, band, height, dx](int b) {
+		const uint64_t* first = grid->arr + (b * band + 1) * dx;
+		const uint64_t* last = grid->arr + std::min((b + 1) * band, height) * dx;
+		std::copy(first, first + dx, m_halos.begin() + 2 * b * dx);
+		std::copy(last, last + dx, m_halos.begin() + (2 * b + 1) * dx);
+	});
+
+	return tbb::parallel_reduce(tbb::blocked_range<int>(0, bands), StepStats{ 0, 0, 0, 0 },
+		[this, grid, seed, band, bands, height, dx, &observe](const tbb::blocked_range<int>& r, StepStats stats) {
+			std::vector<uint64_t> lines(2 * dx);
+			for (int b = r.begin(); b < r.end(); b++) {
+				int y_begin = b * band;
+				int y_end = std::min(y_begin + band, height);
+				if (observe) {
+					observe(y_begin, y_end);
+				}
+				// The padding rows are never written, the outermost bands use them directly
+				const uint64_t* above = b == 0 ? grid->arr : m_halos.data() + (2 * b - 1) * dx;
+				const uint64_t* below = b == bands - 1 ? grid->arr + (height + 1) * dx : m_halos.data() + 2 * (b + 1) * dx;
+				stats = stats + m_inPlace(grid, y_begin, y_end, above, below, lines.data(), seed, m_rule);
+			}
+			return stats;
+		},
+		[](StepStats a, StepStats b) {
+			return a + b;
+		}
+	);
+}
+
+bool CpuStepper::specialized() const {
+	return m_specialized;
+}
@@ -0,0 +1,244 @@
+#include "tuner.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "kernels.h"
+#include "viewport.h"
+
+// CPU rows per task, 0 is each stepper's own
+const int TUNE_BANDS[] = { 0, 4, 16, 64, 256 };
+// Work items per group of the per cell kernels, 0 is the driver's choice
+const int TUNE_LOCAL_SIZES[] = { 0, 32, 64, 128, 256 };
+// Frames before timing starts, the first ones fault in pages and fill caches
+const int TUNE_WARMUP = 3;
+
+static const char* PROFILE_COLUMNS = "width,height,species,rule,backend,device,fused,local_size,band,cells_per_second";
+
+static double elapsed_seconds(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Board cells stepped per second, 0 when the settings can't run
+static double time_frames(int width, int height, int species, Rule rule, const SimulationSettings& settings, double seconds) {
+	Grid* grid = grid_init(width, height, species);
+	grid_seed(grid, default_density(species), settings.seed);
+	Simulation simulation(grid, rule, settings);
+	if (!simulation.ok()) {
+		return 0;
+	}
+	Viewport view = viewport_init(TUNE_SCREEN_WIDTH, TUNE_SCREEN_HEIGHT, width, height);
+	Region region = viewport_region(&view);
+	std::vector<cl_uchar> levels(size_t(region.cols) * region.rows * 2);
+
+	for (int frame = 0; frame < TUNE_WARMUP; frame++) {
+		simulation.frame(region, levels.data());
+		simulation.finish();
+	}
+	auto start = std::chrono::steady_clock::now();
+	int frames = 0;
+	double elapsed;
+	do {
+		simulation.frame(region, levels.data());
+		simulation.finish();
+		frames++;
+		elapsed = elapsed_seconds(start);
+	} while (elapsed < seconds);
+	return double(width) * height * frames / elapsed;
+}
+
+std::string settings_string(const SimulationSettings& settings) {
+	std::ostringstream text;
+	if (settings.backend == Backend::CPU) {
+		text << "cpu, ";
+		if (settings.band) {
+			text << settings.band << " rows per task";
+		} else {
+			text << "default bands";
+		}
+		return text.str();
+	}
+	text << "opencl device " << settings.device << ", ";
+	if (settings.fused) {
+		text << "fused frames";
+	} else {
+		text << "separate passes, ";
+		if (settings.local_size) {
+			text << settings.local_size << " work items per group";
+		} else {
+			text << "driver's group size";
+		}
+	}
+	return text.str();
+}
+
+TuneResult autotune(int width, int height, int species, Rule rule, const SimulationSettings& base, double seconds) {
+	std::vector<SimulationSettings> candidates;
+	for (int band : TUNE_BANDS) {
+		SimulationSettings settings = base;
+		settings.backend = Backend::CPU;
+		settings.band = band;
+		candidates.push_back(settings);
+	}
+	std::vector<cl_device_id> devices = list_devices();
+	for (int device = 0; device < int(devices.size()); device++) {
+		size_t maxGroup = 0;
+		clGetDeviceInfo(devices[device], CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(maxGroup), &maxGroup, nullptr);
+		SimulationSettings settings = base;
+		settings.backend = Backend::OpenCL;
+		settings.device = device;
+		settings.band = 0;
+		settings.fused = true;
+		settings.local_size = 0;
+		candidates.push_back(settings);
+		// Local sizes only reach the per cell kernels of separate passes
+		settings.fused = false;
+		for (int local_size : TUNE_LOCAL_SIZES) {
+			if (size_t(local_size) <= maxGroup) {
+				settings.local_size = local_size;
+				candidates.push_back(settings);
+			}
+		}
+	}
+
+	std::cout << "Tuning a " << width << "x" << height << " board with " << species << " species over "
+		<< candidates.size() << " candidates, " << seconds << "s each\n";
+	TuneResult best = { base, 0 };
+	for (const SimulationSettings& settings : candidates) {
+		double rate = time_frames(width, height, species, rule, settings, seconds);
+		std::cout << "\t" << settings_string(settings) << ": ";
+		if (rate > 0) {
+			std::cout << std::round(rate / 1e6) << "M cells/s\n";
+		} else {
+			std::cout << "unavailable\n";
+		}
+		if (rate > best.cells_per_second) {
+			best = TuneResult{ settings, rate };
+		}
+	}
+	return best;
+}
+
+// What the profile is keyed by, anything that changes the winner
+static std::string host_description() {
+	std::string description;
+	std::ifstream cpuinfo("/proc/cpuinfo");
+	std::string line;
+	while (std::getline(cpuinfo, line)) {
+		if (line.rfind("model name", 0) == 0) {
+			description = line.substr(line.find_first_not_of(" \t", line.find(':') + 1));
+			break;
+		}
+	}
+	description += " x" + std::to_string(std::thread::hardware_concurrency());
+	for (cl_device_id device : list_devices()) {
+		description += "; " + device_name(device);
+	}
+	return description;
+}
+
+static std::filesystem::path profile_directory() {
+	if (const char* dir = getenv("GOL_PROFILE_DIR")) {
+		return dir;
+	}
+	if (const char* dir = getenv("XDG_CONFIG_HOME")) {
+		return std::filesystem::path(dir) / "game-of-life";
+	}
+	if (const char* home = getenv("HOME")) {
+		return std::filesystem::path(home) / ".config" / "game-of-life";
+	}
+	return std::filesystem::temp_directory_path() / "game-of-life";
+}
+
+std::string profile_path() {
+	char name[32];
+	snprintf(name, sizeof(name), "profile-%016llx.csv", (unsigned long long)fnv1a(FNV_OFFSET_BASIS, host_description()));
+	return (profile_directory() / name).string();
+}
+
+// The first four columns of a row, what it's looked up by
+static std::string shape_key(int width, int height, int species, Rule rule) {
+	return std::to_string(width) + "," + std::to_string(height) + "," + std::to_string(species) + "," + rule_string(rule);
+}
+
+bool save_profile(int width, int height, int species, Rule rule, const TuneResult& result) {
+	std::string path = profile_path();
+	std::string key = shape_key(width, height, species, rule);
+	// Other board shapes keep their rows
+	std::vector<std::string> rows;
+	std::ifstream existing(path);
+	std::string line;
+	while (std::getline(existing, line)) {
+		if (!line.empty() && line[0] != '#' && line != PROFILE_COLUMNS && line.rfind(key + ",", 0) != 0) {
+			rows.push_back(line);
+		}
+	}
+	existing.close();
+
+	const SimulationSettings& settings = result.settings;
+	std::ostringstream row;
+	row << key << "," << backend_name(settings.backend) << "," << settings.device << "," << int(settings.fused) << ","
+		<< settings.local_size << "," << settings.band << "," << std::llround(result.cells_per_second);
+	rows.push_back(row.str());
+
+	// Write then rename, so a concurrent launch never reads half a file
+	std::error_code error;
+	std::filesystem::path target = path;
+	std::filesystem::create_directories(target.parent_path(), error);
+	std::filesystem::path temporary = target;
+	temporary += ".tmp" + std::to_string(getpid());
+	{
+		std::ofstream file(temporary);
+		file << "# " << host_description() << "\n" << PROFILE_COLUMNS << "\n";
+		for (const std::string& r : rows) {
+			file << r << "\n";
+		}
+		if (!file) {
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+	}
+	std::filesystem::rename(temporary, target, error);
+	return !error;
+}
+
+bool load_profile(int width, int height, int species, Rule rule, SimulationSettings* settings) {
+	std::ifstream file(profile_path());
+	std::string key = shape_key(width, height, species, rule) + ",";
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.rfind(key, 0) != 0) {
+			continue;
+		}
+		std::istringstream fields(line.substr(key.size()));
+		std::string backend;
+		std::string value;
+		int columns[4];
+		if (!std::getline(fields, backend, ',')) {
+			return false;
+		}
+		for (int c = 0; c < 4; c++) {
+			if (!std::getline(fields, value, ',')) {
+				return false;
+			}
+			columns[c] = atoi(value.c_str());
+		}
+		if (!parse_backend(backend, &settings->backend)) {
+			return false;
+		}
+		settings->device = columns[0];
+		settings->fused = columns[1] != 0;
+		settings->local_size = columns[2];
+		settings->band = columns[3];
+		return true;
+	}
+	return false;
+}
@@ -0,0 +1,124 @@
+#include "viewport.h"
+#include <algorithm>
+#include <cmath>
+
+static int cells_per_point(int level) {
+	return level > 0 ? 1 << level : 1;
+}
+
+static int points_per_cell(int level) {
+	return level < 0 ? 1 << -level : 1;
+}
+
+static void clamp(Viewport* view) {
+	int step = cells_per_point(view->level);
+	int visible_width = view->screen_width / points_per_cell(view->level) * step;
+	int visible_height = view->screen_height / points_per_cell(view->level) * step;
+	view->x = std::clamp(view->x, 0, std::max(0, view->board_width - visible_width));
+	view->y = std::clamp(view->y, 0, std::max(0, view->board_height - visible_height));
+	// Keep blocks aligned so the reduced image doesn't shimmer while panning
+	view->x -= view->x % step;
+	view->y -= view->y % step;
+}
+
+Viewport viewport_init(int screen_width, int screen_height, int board_width, int board_height) {
+	Viewport view;
+	view.screen_width = screen_width;
+	view.screen_height = screen_height;
+	view.board_width = board_width;
+	view.board_height = board_height;
+	view.level = 0;
+	view.x = 0;
+	view.y = 0;
+	viewport_fit(&view);
+	return view;
+}
+
+void viewport_fit(Viewport* view) {
+	int level = MIN_LEVEL;
+	while (level < MAX_LEVEL) {
+		int step = cells_per_point(level);
+		int cols = view->screen_width / points_per_cell(level);
+		int rows = view->screen_height / points_per_cell(level);
+		if ((long)cols * step >= view->board_width && (long)rows * step >= view->board_height) {
+			break;
+		}
+		level++;
+	}
+	view->level = level;
+	view->x = 0;
+	view->y = 0;
+	clamp(view);
+}
+
+void viewport_zoom(Viewport* view, int levels, double screen_x, double screen_y) {
+	int level = std::clamp(view->level + levels, MIN_LEVEL, MAX_LEVEL);
+	if (level == view->level) {
+		return;
+	}
+
+	// Keep the cell under (screen_x, screen_y) in place
+	double scale = double(cells_per_point(view->level)) / points_per_cell(view->level);
+	double cell_x = view->x + screen_x * scale;
+	double cell_y = view->y + screen_y * scale;
+
+	view->level = level;
+	scale = double(cells_per_point(level)) / points_per_cell(level);
+	view->x = (int)std::floor(cell_x - screen_x * scale);
+	view->y = (int)std::floor(cell_y - screen_y * scale);
+	clamp(view);
+}
+
+void viewport_pan(Viewport* view, double dx, double dy) {
+	double scale = double(cells_per_point(view->level)) / points_per_cell(view->level);
+	int step = cells_per_point(view->level);
+	// Round away from zero so small drags at high levels still move a block
+	int cells_x = (int)std::round(dx * scale);
+	int cells_y = (int)std::round(dy * scale);
+	if (cells_x != 0 && std::abs(cells_x) < step) {
+		cells_x = cells_x < 0 ? -step : step;
+	}
+	if (cells_y != 0 && std::abs(cells_y) < step) {
+		cells_y = cells_y < 0 ? -step : step;
+	}
+	view->x += cells_x;
+	view->y += cells_y;
+	clamp(view);
+}
+
+Region viewport_region(const Viewport* view) {
+	Region region;
+	region.step = cells_per_point(view->level);
+	region.point_size = points_per_cell(view->level);
+	region.x = view->x;
+	region.y = view->y;
+
+	int screen_cols = view->screen_width / region.point_size;
+	int screen_rows = view->screen_height / region.point_size;
+	int board_cols = (view->board_width - view->x + region.step - 1) / region.step;
+	int board_rows = (view->board_height - view->y + region.step - 1) / region.step;
+	region.cols = std::min(screen_cols, board_cols);
+	region.rows = std::min(screen_rows, board_rows);
+
+	region.offset_x = (view->screen_width - region.cols * region.point_size) / 2;
+	region.offset_y = (view->screen_height - region.rows * region.point_size) / 2;
+	if (region.cols == screen_cols) {
+		region.offset_x = 0;
+	}
+	if (region.rows == screen_rows) {
+		region.offset_y = 0;
+	}
+	return region;
+}
+
+bool viewport_cell(const Viewport* view, double screen_x, double screen_y, int* x, int* y) {
+	Region region = viewport_region(view);
+	double col = std::floor((screen_x - region.offset_x) / region.point_size);
+	double row = std::floor((screen_y - region.offset_y) / region.point_size);
+	if (col < 0 || row < 0 || col >= region.cols || row >= region.rows) {
+		return false;
+	}
+	*x = std::min(region.x + int(col) * region.step + region.step / 2, view->board_width - 1);
+	*y = std::min(region.y + int(row) * region.step + region.step / 2, view->board_height - 1);
+	return true;
+}
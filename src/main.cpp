@@ -1,14 +1,45 @@
 #include "window.h"
 #include "GLFW/glfw3.h"
+#include "counters.h"
 #include "shader.h"
+#include "ensemble.h"
+#include "frame_ring.h"
 #include "game_of_life.h"
+#include "offscreen.h"
+#include "options.h"
+#include "out_of_core.h"
+#include "pattern.h"
+#include "tuner.h"
+#include "viewport.h"
 #include "config.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <memory>
 #include <random>
 
 #define BACKGROUND_COLOR 0.0f, 0.0f, 0.0f, 0.0f
 
-const int MAX_SPECIES = 16;
 bool key_pressed = false;
+Viewport viewport;
+bool dragging = false;
+double drag_x = 0;
+double drag_y = 0;
+bool paused = false;
+int64_t travel = 0; // generations to move through the history before the next frame
+// Generations a shifted [ or ] moves
+const int TRAVEL_JUMP = 100;
+// Right button paints, erasing with shift
+bool painting = false;
+bool erasing = false;
+bool stroke_started = false;
+int stroke_x = 0; // last cell painted, strokes are filled in from it
+int stroke_y = 0;
+int brush_species = 1;
+int brush_radius = 2;
+const int MAX_BRUSH_RADIUS = 64;
+bool stamp_pattern = false; // E stamps the pattern at the cursor next frame
+bool clear_visible = false;
 
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -20,46 +51,135 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 		glfwSetWindowShouldClose(window, true);
 	}
 
+	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+		paused = !paused;
+	}
 
+	if (action != GLFW_PRESS && action != GLFW_REPEAT) {
+		return;
+	}
+	double pan_x = viewport.screen_width / 4.0;
+	double pan_y = viewport.screen_height / 4.0;
+	switch (key) {
+		case GLFW_KEY_LEFT:
+		case GLFW_KEY_A:
+			viewport_pan(&viewport, -pan_x, 0);
+			break;
+		case GLFW_KEY_RIGHT:
+		case GLFW_KEY_D:
+			viewport_pan(&viewport, pan_x, 0);
+			break;
+		case GLFW_KEY_UP:
+		case GLFW_KEY_W:
+			viewport_pan(&viewport, 0, pan_y);
+			break;
+		case GLFW_KEY_DOWN:
+		case GLFW_KEY_S:
+			viewport_pan(&viewport, 0, -pan_y);
+			break;
+		case GLFW_KEY_EQUAL:
+		case GLFW_KEY_KP_ADD:
+			viewport_zoom(&viewport, -1, viewport.screen_width / 2.0, viewport.screen_height / 2.0);
+			break;
+		case GLFW_KEY_MINUS:
+		case GLFW_KEY_KP_SUBTRACT:
+			viewport_zoom(&viewport, 1, viewport.screen_width / 2.0, viewport.screen_height / 2.0);
+			break;
+		case GLFW_KEY_F:
+			viewport_fit(&viewport);
+			break;
+		case GLFW_KEY_LEFT_BRACKET:
+			travel -= (mods & GLFW_MOD_SHIFT) ? TRAVEL_JUMP : 1;
+			break;
+		case GLFW_KEY_RIGHT_BRACKET:
+			travel += (mods & GLFW_MOD_SHIFT) ? TRAVEL_JUMP : 1;
+			break;
+		case GLFW_KEY_COMMA:
+			brush_radius = std::max(brush_radius - 1, 0);
+			break;
+		case GLFW_KEY_PERIOD:
+			brush_radius = std::min(brush_radius + 1, MAX_BRUSH_RADIUS);
+			break;
+		case GLFW_KEY_E:
+			stamp_pattern = true;
+			break;
+		case GLFW_KEY_BACKSPACE:
+		case GLFW_KEY_DELETE:
+			clear_visible = true;
+			break;
+	}
+	if (key >= GLFW_KEY_1 && key <= GLFW_KEY_9) {
+		brush_species = key - GLFW_KEY_1 + 1;
+	}
 }
 
-int parse_species_arguments(int argc, char* argv[]) {
-	int species = 5;
-	if (argc >= 2) {
-		int species_arg = atoi(argv[1]);
-		if (species_arg >= 5 && species_arg <= 10) {
-			std::cout << "Starting game of life with " << species_arg << " species\n";
-			species = species_arg;
-		} else if (argc == 3) {
-			if (std::string(argv[2]) == "--force") {
-				if (species_arg > MAX_SPECIES) {
-					std::cout << "Only " << MAX_SPECIES << " colors are supported, defaulting to " << MAX_SPECIES << "\n";
-					species = MAX_SPECIES;
-				} else {
-					std::cout << "Starting game of life with " << species_arg << " species\n";
-					species = species_arg;
-				}
-			} else {
-				std::cout << argv[2] << "\n";
-			}
-		} else {
-			std::cout << "Invalid argument was given, defaulting to 5\n";
+void scrollCallback(GLFWwindow* window, double x_offset, double y_offset) {
+	double x, y;
+	glfwGetCursorPos(window, &x, &y);
+	int levels = y_offset > 0 ? -1 : 1;
+	viewport_zoom(&viewport, levels, x, viewport.screen_height - y);
+}
+
+void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+	if (button == GLFW_MOUSE_BUTTON_LEFT) {
+		dragging = action == GLFW_PRESS;
+		glfwGetCursorPos(window, &drag_x, &drag_y);
+	}
+	if (button == GLFW_MOUSE_BUTTON_RIGHT) {
+		painting = action == GLFW_PRESS;
+		erasing = mods & GLFW_MOD_SHIFT;
+		stroke_started = false;
+	}
+}
+
+/* Queues the edits asked for since the last frame. A stroke is stamped a
+ * brush radius apart from the last cell painted, so fast drags don't leave
+ * gaps. */
+void queue_edits(GLFWwindow* window, GameOfLife* game, const Pattern* pattern) {
+	double cursor_x;
+	double cursor_y;
+	glfwGetCursorPos(window, &cursor_x, &cursor_y);
+	int x;
+	int y;
+	bool on_board = viewport_cell(&viewport, cursor_x, viewport.screen_height - cursor_y, &x, &y);
+
+	if (painting && on_board) {
+		Pattern brush = brush_pattern(brush_radius);
+		if (!stroke_started) {
+			stroke_x = x;
+			stroke_y = y;
+			stroke_started = true;
 		}
-	} else {
-		std::cout << "Defaulting to 5 species since none were entered\n";
+		int dx = x - stroke_x;
+		int dy = y - stroke_y;
+		int stamps = std::max(1, std::max(std::abs(dx), std::abs(dy)) / std::max(brush_radius, 1));
+		for (int i = 1; i <= stamps; i++) {
+			game->stamp(stroke_x + dx * i / stamps, stroke_y + dy * i / stamps, brush, erasing ? 0 : brush_species, true);
+		}
+		stroke_x = x;
+		stroke_y = y;
+	}
+	if (stamp_pattern && pattern && on_board) {
+		game->stamp(x, y, *pattern, brush_species, false);
+	}
+	stamp_pattern = false;
+	if (clear_visible) {
+		Region region = viewport_region(&viewport);
+		game->clear(region.x, region.y, region.cols * region.step, region.rows * region.step);
+		clear_visible = false;
 	}
-	return species;
 }
 
-// Function actually used by GPU
-// https://www.reedbeta.com/blog/hash-functions-for-gpu-rendering/
-uint pcg_hash(uint input)
-{
-    uint state = input * 747796405u + 2891336453u;
-    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
-    return (word >> 22u) ^ word;
+void cursorPosCallback(GLFWwindow* window, double x, double y) {
+	if (!dragging) {
+		return;
+	}
+	viewport_pan(&viewport, drag_x - x, y - drag_y);
+	drag_x = x;
+	drag_y = y;
 }
 
+// pcg_hash is the same function the kernel uses for tie-breaks
 void display_randomness(int n) {
 	std::mt19937_64 rng(std::random_device{}());
 	std::uniform_int_distribution<uint64_t> dist(0ULL, ~(0ULL));
@@ -80,6 +200,332 @@ void display_randomness(int n) {
 	std::cout << "\n";
 }
 
+// Headless: steps every board of the batch together and writes their statistics
+int run_batch(const Options& options) {
+	std::vector<BoardSpec> specs;
+	if (!read_board_specs(options.batch, &specs)) {
+		int count = atoi(options.batch.c_str());
+		if (count <= 0) {
+			std::cout << "Batch " << options.batch << " is neither a spec file nor a board count\n";
+			return 1;
+		}
+		specs = sweep_board_specs(count, options.board_width, options.board_height, options.settings.seed);
+	}
+	if (specs.empty()) {
+		std::cout << "No boards to run\n";
+		return 1;
+	}
+
+	std::cout << "Running " << specs.size() << " boards for up to " << options.generations << " generations on "
+		<< backend_name(options.settings.backend) << "\n";
+	Ensemble ensemble(specs, options.rule, options.settings);
+	if (!ensemble.ok()) {
+		return 1;
+	}
+	ensemble.run(options.generations);
+	std::cout << "\t" << std::round(ensemble.cellsPerSecond() / 1e6) << "M cells/s across the ensemble\n";
+
+	if (!ensemble.writeCsv(options.stats)) {
+		std::cout << "Could not write " << options.stats << "\n";
+		return 1;
+	}
+	std::cout << "Statistics written to " << options.stats << "\n";
+	return 0;
+}
+
+volatile sig_atomic_t serving = 1;
+
+void stopServing(int) {
+	serving = 0;
+}
+
+// Steps one board without a window and publishes it for other processes
+int run_server(const Options& options) {
+	Grid* grid = grid_init(options.board_width, options.board_height, options.species);
+	grid_seed(grid, default_density(options.species), options.settings.seed);
+	Simulation simulation(grid, options.rule, options.settings);
+	if (!simulation.ok()) {
+		std::cout << "Could not set up " << backend_name(options.settings.backend) << ", nothing to serve\n";
+		return 1;
+	}
+	FrameRing* ring = FrameRing::create(options.serve, grid);
+	if (!ring) {
+		return 1;
+	}
+	signal(SIGINT, stopServing);
+	signal(SIGTERM, stopServing);
+
+	std::cout << "Serving a " << grid->width << "x" << grid->height << " board as " << options.serve
+		<< " every " << options.every << " generation(s), attach with --attach " << options.serve << "\n";
+	simulation.read(ring->begin());
+	ring->publish(FrameInfo{ 0, (uint64_t)get_active_points(grid), simulation.hash() });
+
+	auto report_start = std::chrono::steady_clock::now();
+	int report_generations = 0;
+	for (int generation = 1; serving && (options.generations == 0 || generation <= options.generations); generation++) {
+		simulation.step();
+		if (generation % options.every == 0) {
+			cl_uint population = simulation.count();
+			simulation.read(ring->begin());
+			simulation.finish();
+			ring->publish(FrameInfo{ (uint64_t)generation, population, simulation.hash() });
+		}
+
+		report_generations++;
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - report_start).count();
+		if (seconds >= 1.0) {
+			std::cout << " Generation " << generation << ", " << std::round(report_generations / seconds) << " generations/s \r" << std::flush;
+			report_start = std::chrono::steady_clock::now();
+			report_generations = 0;
+		}
+	}
+	std::cout << "\nStopped serving " << options.serve << "\n";
+	delete ring;
+	return 0;
+}
+
+// First cell where two boards differ, false when they match
+static bool first_difference(const Grid* a, const Grid* b, int* x, int* y) {
+	for (int row = 0; row < a->height; row++) {
+		for (int col = 0; col < a->width; col++) {
+			int i = (row+1) * (a->width+2) + (col+1);
+			if (a->arr[i] != b->arr[i]) {
+				*x = col;
+				*y = row;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static int species_of(uint64_t value) {
+	return value ? __builtin_ctzll(value) / 4 + 1 : 0;
+}
+
+/* Steps the same seeded board on two backends in lock step and stops at
+ * the first generation their hashes disagree */
+int run_check(const Options& options) {
+	std::string first = options.check.substr(0, options.check.find(','));
+	std::string second = options.check.find(',') == std::string::npos ? "" : options.check.substr(options.check.find(',') + 1);
+	SimulationSettings settings[2] = { options.settings, options.settings };
+	if (!parse_backend(first, &settings[0].backend) || !parse_backend(second, &settings[1].backend)) {
+		std::cout << "Expected two backends to compare, like --check opencl,cpu\n";
+		return 1;
+	}
+
+	// Each simulation owns its grid
+	std::unique_ptr<Simulation> simulations[2];
+	for (int s = 0; s < 2; s++) {
+		Grid* grid = grid_init(options.board_width, options.board_height, options.species);
+		grid_seed(grid, default_density(options.species), options.settings.seed);
+		simulations[s].reset(new Simulation(grid, options.rule, settings[s]));
+		if (!simulations[s]->ok()) {
+			std::cout << "Could not set up " << (s ? second : first) << ", nothing was checked\n";
+			return 1;
+		}
+	}
+	int generations = options.generations > 0 ? options.generations : 1000;
+	std::cout << "Checking " << first << " against " << second << " on a " << options.board_width << "x" << options.board_height
+		<< " board for " << generations << " generations\n";
+	// Where each board is read back to when their hashes are compared
+	std::vector<uint64_t> cells[2];
+	Grid boards[2];
+	for (int s = 0; s < 2; s++) {
+		cells[s].resize(size_t(options.board_width + 2) * (options.board_height + 2));
+		boards[s] = Grid{ options.board_height, options.board_width, options.species, cells[s].data() };
+	}
+	for (int generation = 1; generation <= generations; generation++) {
+		// Both run at once, the device step is asynchronous
+		simulations[0]->step();
+		simulations[1]->step();
+		simulations[0]->finish();
+		simulations[1]->finish();
+		bool last = generation == generations;
+		if (simulations[0]->hash() == simulations[1]->hash() && !last) {
+			continue;
+		}
+
+		simulations[0]->read(boards[0].arr);
+		simulations[1]->read(boards[1].arr);
+		int x;
+		int y;
+		if (first_difference(&boards[0], &boards[1], &x, &y)) {
+			uint64_t a = check(&boards[0], x, y);
+			uint64_t b = check(&boards[1], x, y);
+			std::cout << "Generation " << generation << " differs first at (" << x << ", " << y << "): "
+				<< first << " has species " << species_of(a) << ", " << second << " has species " << species_of(b) << "\n";
+			return 1;
+		}
+		if (simulations[0]->hash() != simulations[1]->hash()) {
+			std::cout << "Generation " << generation << " boards match but their hashes don't, the hash updates disagree\n";
+			return 1;
+		}
+	}
+	std::cout << "Backends agree for " << generations << " generations\n";
+	return 0;
+}
+
+/* Steps a board kept in a file, creating it first when it doesn't exist,
+ * until the generation limit or until it dies out or settles */
+int run_out_of_core(const Options& options) {
+	OutOfCoreBoard* board = OutOfCoreBoard::open(options.out_of_core);
+	if (board) {
+		std::cout << "Resuming " << options.out_of_core << " at generation " << board->header().generation << "\n";
+	} else {
+		std::cout << "Creating a " << options.board_width << "x" << options.board_height << " board in " << options.out_of_core << "\n";
+		board = OutOfCoreBoard::create(options.out_of_core, options.board_width, options.board_height, options.species, options.rule, options.settings.seed);
+		if (!board) {
+			return 1;
+		}
+	}
+	board->setWindow(options.window);
+	const BoardFileHeader& header = board->header();
+	uint64_t cells = uint64_t(header.width) * header.height;
+	std::cout << header.width << "x" << header.height << " board, " << header.species << " species, rule "
+		<< rule_string(Rule{ header.birth, header.survive }) << ", " << board->bandRows() << " rows per band\n";
+
+	CycleDetector cycles;
+	cycles.push(header.hash, false);
+	auto start = std::chrono::steady_clock::now();
+	int stepped = 0;
+	while (options.generations == 0 || stepped < options.generations) {
+		StepStats stats = board->step();
+		stepped++;
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::cout << " Generation " << header.generation << ", " << stats.population << " alive, "
+			<< std::round(stepped * 3600.0 / seconds * 10) / 10 << " generations/hour ("
+			<< std::round(stepped * cells / seconds / 1e6) << "M cells/s) \r" << std::flush;
+
+		if (stats.population == 0) {
+			std::cout << "\nDied out at generation " << header.generation << "\n";
+			break;
+		}
+		int period = cycles.push(header.hash, stats.ties > 0);
+		if (period) {
+			std::cout << "\nSettled into a period " << period << " cycle at generation " << header.generation << "\n";
+			break;
+		}
+	}
+	std::cout << "\n";
+	delete board;
+	return 0;
+}
+
+// Counters for --perf, nullptr with a message when the kernel won't count
+PerfCounters* start_counters() {
+	PerfCounters* counters = new PerfCounters();
+	if (!counters->ok()) {
+		std::cout << "Hardware counters are unavailable, check /proc/sys/kernel/perf_event_paranoid\n";
+		delete counters;
+		return nullptr;
+	}
+	return counters;
+}
+
+/* Draws every generation into an offscreen framebuffer with no window or
+ * vsync in the way, recording the frames when given somewhere to put them */
+int run_offscreen(const Options& options, int width, int height) {
+	if (!offscreen_init()) {
+		return 1;
+	}
+	Shader shader("vertex.glsl", "fragment.glsl");
+	// Before the board, so a target that can't be opened has nothing else to clean up
+	FrameRecorder* recorder = nullptr;
+	if (!options.record.empty()) {
+		recorder = new FrameRecorder(width, height, options.record);
+		if (!recorder->ok()) {
+			delete recorder;
+			offscreen_terminate();
+			return 1;
+		}
+	}
+	PerfCounters* counters = options.perf ? start_counters() : nullptr;
+	if (counters) {
+		counters->begin(Phase::Init);
+	}
+	Grid* grid = grid_init(options.board_width, options.board_height, options.species);
+	grid_seed(grid, default_density(options.species), options.settings.seed);
+	GameOfLife* game = new GameOfLife(grid, options.rule, options.settings, width, height, 1.0f);
+	if (!game->ok()) {
+		std::cout << "Could not set up " << backend_name(options.settings.backend) << ", nothing to render\n";
+		delete game;
+		delete counters;
+		delete recorder;
+		offscreen_terminate();
+		return 1;
+	}
+	if (counters) {
+		counters->end(Phase::Init, uint64_t(grid->width) * grid->height);
+		game->setCounters(counters);
+	}
+	Viewport view = viewport_init(width, height, options.board_width, options.board_height);
+
+	glDisable(GL_DEPTH_TEST);
+	glPolygonMode(GL_FRONT_AND_BACK, GL_POINTS);
+
+	auto start = std::chrono::steady_clock::now();
+	int frames = 0;
+	while (options.generations == 0 || frames < options.generations) {
+		if (recorder) {
+			recorder->begin();
+		}
+		glClearColor(BACKGROUND_COLOR);
+		glClear(GL_COLOR_BUFFER_BIT);
+		shader.use();
+		game->step(viewport_region(&view));
+		if (recorder) {
+			recorder->end();
+		} else {
+			glFlush();
+		}
+		frames++;
+		if (frames % 100 == 0) {
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			std::cout << " Frame " << frames << ", " << std::round(frames / seconds) << " frames/s \r" << std::flush;
+		}
+	}
+	bool recorded = true;
+	if (recorder) {
+		recorded = recorder->finish();
+	} else {
+		glFinish();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	std::cout << "\nRendered " << frames << " " << width << "x" << height << " frames in " << std::round(seconds * 100) / 100
+		<< "s (" << std::round(frames / seconds) << " frames/s)\n";
+	if (counters) {
+		counters->report();
+	}
+
+	delete recorder;
+	delete game;
+	delete counters;
+	offscreen_terminate();
+	return recorded ? 0 : 1;
+}
+
+/* Times every backend on the board about to be run and keeps the fastest in
+ * the host's profile, which later launches of the same board pick up */
+int run_autotune(const Options& options) {
+	TuneResult result = autotune(options.board_width, options.board_height, options.species, options.rule, options.settings);
+	if (result.cells_per_second <= 0) {
+		std::cout << "Nothing could step the board\n";
+		return 1;
+	}
+	std::cout << "Fastest is " << settings_string(result.settings) << " at " << std::round(result.cells_per_second / 1e6) << "M cells/s\n";
+	if (!save_profile(options.board_width, options.board_height, options.species, options.rule, result)) {
+		std::cout << "Could not write " << profile_path() << "\n";
+		return 1;
+	}
+	std::cout << "Saved to " << profile_path() << "\n";
+	return 0;
+}
+
+void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
+	glViewport(0, 0, width, height);
+}
+
 int main(int argc, char* argv[]) {
 	/*
 	display_randomness(10000);
@@ -90,14 +536,13 @@ int main(int argc, char* argv[]) {
 	const int height = 784; // 784
 	const int width = 1024; // 1024
 #ifdef DEBUG_MODE
-	const int grid_height = 49;
-	const int grid_width = 64;
+	int grid_height = 49;
+	int grid_width = 64;
 #else
-	const int grid_height = height;
-	const int grid_width = width;
+	int grid_height = height;
+	int grid_width = width;
 #endif
 	const double target_fps = 120;
-	const float point_size = float(width) / float(grid_width) * 2;
 
 
 	std::cout << "\n";
@@ -131,29 +576,98 @@ int main(int argc, char* argv[]) {
 	std::cout << "\n";
 
 
-	int species = parse_species_arguments(argc, argv);
+	Options options = parse_options(argc, argv, grid_width, grid_height);
+	grid_width = options.board_width;
+	grid_height = options.board_height;
+	if (options.autotune) {
+		return run_autotune(options);
+	}
+	if (!options.batch.empty()) {
+		return run_batch(options);
+	}
+	if (!options.serve.empty()) {
+		return run_server(options);
+	}
+	if (!options.check.empty()) {
+		return run_check(options);
+	}
+	if (!options.out_of_core.empty()) {
+		return run_out_of_core(options);
+	}
+	if (options.offscreen) {
+		return run_offscreen(options, width, height);
+	}
+
+	FrameRing* ring = nullptr;
+	if (!options.attach.empty()) {
+		ring = FrameRing::attach(options.attach);
+		if (!ring) {
+			std::cout << "Nothing is serving " << options.attach << ", start one with --serve " << options.attach << "\n";
+			return 1;
+		}
+		grid_width = ring->width();
+		grid_height = ring->height();
+		std::cout << "Attached to a " << grid_width << "x" << grid_height << " board served as " << options.attach << "\n";
+	}
+
 	GLFWwindow* window = init_window(width, height, "Game of Life");
+	// Framebuffer pixels per window point, 2 on a retina display
+	int framebuffer_width;
+	int framebuffer_height;
+	glfwGetFramebufferSize(window, &framebuffer_width, &framebuffer_height);
+	const float point_scale = float(framebuffer_width) / width;
 	Shader shader("vertex.glsl", "fragment.glsl");
-	Grid* grid = grid_init(grid_width, grid_height, species);
-	int total_points = get_active_points(grid);
-	double points_percentage = double(total_points) / double(grid->height * grid->width) * 100;
-	std::cout << "Populated " << total_points << " squares (" << std::round(points_percentage) << "%)\n";
-
-	GameOfLife game(grid);
+	PerfCounters* counters = options.perf ? start_counters() : nullptr;
+	if (counters) {
+		counters->begin(Phase::Init);
+	}
+	GameOfLife* game;
+	if (ring) {
+		game = new GameOfLife(ring, width, height, point_scale);
+	} else {
+		Grid* grid = grid_init(grid_width, grid_height, options.species);
+		grid_seed(grid, default_density(options.species), options.settings.seed);
+		int total_points = get_active_points(grid);
+		double points_percentage = double(total_points) / (double(grid->height) * grid->width) * 100;
+		std::cout << "Populated " << total_points << " squares (" << std::round(points_percentage) << "%)\n";
+		game = new GameOfLife(grid, options.rule, options.settings, width, height, point_scale, options.history);
+	}
+	if (!game->ok()) {
+		std::cout << "Could not set up " << backend_name(options.settings.backend) << ", try --backend cpu\n";
+		delete game;
+		delete counters;
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return 1;
+	}
+	if (counters) {
+		counters->end(Phase::Init, uint64_t(grid_width) * grid_height);
+		game->setCounters(counters);
+	}
+	viewport = viewport_init(width, height, grid_width, grid_height);
+	Pattern pattern;
+	bool has_pattern = false;
+	if (!options.pattern.empty()) {
+		has_pattern = read_rle(options.pattern, &pattern);
+		if (has_pattern) {
+			std::cout << "Loaded a " << pattern.width << "x" << pattern.height << " pattern, E stamps it at the cursor\n";
+		} else {
+			std::cout << "Could not read an RLE pattern from " << options.pattern << "\n";
+		}
+	}
 
-#ifdef __APPLE__
-	glViewport(0, 0, width * 2, height * 2);
-#else
-	glViewport(0, 0, WIDTH, HEIGHT);
-#endif
+	glViewport(0, 0, framebuffer_width, framebuffer_height);
+	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
 	glfwSwapInterval(1);
 
 	glDisable(GL_DEPTH_TEST);
 	glPolygonMode(GL_FRONT_AND_BACK, GL_POINTS);
-	glPointSize(point_size);
 
 	glfwSetKeyCallback(window, keyCallback);
+	glfwSetScrollCallback(window, scrollCallback);
+	glfwSetMouseButtonCallback(window, mouseButtonCallback);
+	glfwSetCursorPosCallback(window, cursorPosCallback);
 
 	const double target_frame_time = 1.0 / target_fps;
 	double average_frame_time = 0;
@@ -161,6 +675,7 @@ int main(int argc, char* argv[]) {
 	int frames_passed = 0;
 	double total_frame_time = 0;
 	int cell_count = 0;
+	int cycle_period = 0;
 
 	while (!glfwWindowShouldClose(window)) {
 
@@ -171,12 +686,38 @@ int main(int argc, char* argv[]) {
 
 		shader.use();
 
-		cell_count = game.step();
+		if (travel) {
+			if (game->travel(travel)) {
+				paused = true;
+				const History* history = game->history();
+				std::cout << "\nGeneration " << history->generation() << ", history holds " << history->oldest()
+					<< " to " << history->newest() << " in " << (history->used() >> 20) << "MB, P resumes\n";
+			} else {
+				std::cout << "\nNo history to rewind through, start with --history MB\n";
+			}
+			travel = 0;
+		}
+		queue_edits(window, game, has_pattern ? &pattern : nullptr);
+		game->setPaused(paused);
+
+		Region region = viewport_region(&viewport);
+		cell_count = game->step(region);
 
 #ifndef DEBUG_MODE
 		cell_count /= 1000;
 #endif
 
+		const Simulation* simulation = game->simulation();
+		if (simulation && simulation->cycles().period() != cycle_period) {
+			const CycleDetector& cycles = simulation->cycles();
+			cycle_period = cycles.period();
+			if (cycle_period == 1) {
+				std::cout << "\nBoard stopped changing at generation " << cycles.confirmedAt() << "\n";
+			} else if (cycle_period) {
+				std::cout << "\nBoard settled into a period " << cycle_period << " cycle at generation " << cycles.confirmedAt() << "\n";
+			}
+		}
+
 		glfwSwapBuffers(window);
 
 		glfwPollEvents();
@@ -216,6 +757,10 @@ int main(int argc, char* argv[]) {
 			} else {
 				std::cout <<  "\t" <<std::round(fps_450) << " average fps\n";
 			}
+			if (counters) {
+				std::cout << "Hardware counters per frame, summed over every thread:\n";
+				counters->report();
+			}
 		}
 #ifdef DEBUG_MODE
 		while (!key_pressed) {
@@ -226,6 +771,9 @@ int main(int argc, char* argv[]) {
 	}
 
 	std::cout << "\n";
+	delete game;
+	delete counters;
+	delete ring;
 	glfwDestroyWindow(window);
 	glfwTerminate();
 
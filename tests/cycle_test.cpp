@@ -0,0 +1,58 @@
+#include "check.h"
+#include "cycle.h"
+#include "stepper.h"
+
+int main() {
+	// A blinker comes back every other generation
+	Grid* grid = grid_init(16, 16, 1);
+	Grid* next = grid_init(16, 16, 1);
+	clear(grid);
+	clear(next);
+	set(grid, 5, 5, 1);
+	set(grid, 6, 5, 1);
+	set(grid, 7, 5, 1);
+	CpuStepper stepper(1, CONWAY);
+	CycleDetector detector;
+	uint64_t hash = board_hash(grid);
+	detector.push(hash, false);
+	int confirmed = 0;
+	for (int generation = 1; generation <= 8; generation++) {
+		StepStats stats = stepper.step(grid, next, generation);
+		std::swap(grid, next);
+		hash ^= stats.hash;
+		CHECK(hash == board_hash(grid));
+		int period = detector.push(hash, stats.ties > 0);
+		if (period && !confirmed) {
+			confirmed = generation;
+		}
+		CHECK(period == 0 || period == 2);
+	}
+	// Back at 2, repeated for a whole period by 3
+	CHECK(confirmed == 3);
+	CHECK(detector.period() == 2 && detector.confirmedAt() == 3);
+	grid_free(grid);
+	grid_free(next);
+
+	// A still life has period 1
+	CycleDetector still;
+	CHECK(still.push(7, false) == 0);
+	CHECK(still.push(7, false) == 1);
+
+	// A tie-break inside the period could lead anywhere, so nothing is confirmed
+	CycleDetector random;
+	for (int generation = 0; generation < 10; generation++) {
+		CHECK(random.push(generation % 3, generation % 3 == 1) == 0);
+	}
+
+	// Leaving the cycle drops the period, reset forgets everything
+	CycleDetector left;
+	for (int generation = 0; generation < 6; generation++) {
+		left.push(generation % 2, false);
+	}
+	CHECK(left.period() == 2);
+	left.push(99, true);
+	CHECK(left.period() == 0);
+	left.reset();
+	CHECK(left.period() == 0 && left.generation() == -1);
+	return check_failures;
+}
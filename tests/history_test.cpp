@@ -0,0 +1,54 @@
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+#include "check.h"
+#include "history.h"
+#include "simulation.h"
+
+int main() {
+	const int width = 150;
+	const int height = 130;
+	const int species = 4;
+	// Budgets of a few boards evict early and often, a roomier one keeps everything
+	for (size_t boards : { 4, 6, 40 }) {
+		Grid* grid = grid_init(width, height, species);
+		grid_seed(grid, default_density(species), 3);
+		SimulationSettings settings = DEFAULT_SETTINGS;
+		settings.backend = Backend::CPU;
+		settings.seed = 5;
+		Simulation simulation(grid, CONWAY, settings);
+		size_t boardBytes = size(grid) * sizeof(uint64_t);
+		History history(simulation.grid(), 0, boards * boardBytes, 16);
+		CHECK(history.ok());
+		if (!history.ok()) {
+			continue;
+		}
+
+		std::map<uint64_t, std::vector<uint64_t>> expected;
+		expected[0].assign(grid->arr, grid->arr + size(grid));
+		std::mt19937 rng(1);
+		for (int i = 0; i < 1500; i++) {
+			if (rng() % 100 < 97) {
+				simulation.step();
+				simulation.finish();
+				history.push(simulation.grid(), simulation.generation());
+				expected[simulation.generation()].assign(simulation.grid()->arr, simulation.grid()->arr + size(grid));
+				CHECK(history.used() <= boards * boardBytes);
+				continue;
+			}
+			// Rewind somewhere retained and carry on from there
+			uint64_t oldest = history.oldest();
+			uint64_t newest = history.newest();
+			uint64_t target = oldest + rng() % (newest - oldest + 1);
+			CHECK(history.seek(target));
+			CHECK(history.generation() == target);
+			CHECK(std::memcmp(history.board()->arr, expected[target].data(), boardBytes) == 0);
+			CHECK(!history.seek(newest + 1));
+			CHECK(oldest == 0 || !history.seek(oldest - 1));
+			simulation.load(history.board()->arr, target);
+		}
+		CHECK(boards == 40 ? history.oldest() == 0 : history.oldest() > 0);
+	}
+	return check_failures;
+}
@@ -0,0 +1,47 @@
+#include <vector>
+#include "check.h"
+#include "pattern.h"
+
+static const char* GLIDER = "#C glider\nx = 3, y = 3, rule = B3/S23\nbo$2bo$3o!";
+static const char* STATES = "x = 4, y = 2\n.AB$C2.A!";
+
+int main() {
+	Pattern glider;
+	CHECK(parse_rle(GLIDER, &glider));
+	CHECK(glider.width == 3 && glider.height == 3);
+	CHECK(glider.cells == std::vector<uint8_t>({ 0, 1, 0, 0, 0, 1, 1, 1, 1 }));
+
+	Pattern states;
+	CHECK(parse_rle(STATES, &states));
+	CHECK(states.width == 4 && states.height == 2);
+	CHECK(states.cells == std::vector<uint8_t>({ 0, 1, 2, 0, 3, 0, 0, 1 }));
+
+	Pattern rejected;
+	CHECK(!parse_rle("x = 2, y = 1\n3o!", &rejected)); // runs past the width
+	CHECK(!parse_rle("bo$2bo!", &rejected)); // no header
+	CHECK(!parse_rle("x = 0, y = 1\n!", &rejected));
+
+	// Bottom row first, in the species asked for
+	std::vector<uint64_t> cells(9);
+	pattern_cells(glider, 2, 3, false, cells.data());
+	const uint64_t live = 1ULL << 4;
+	CHECK(cells == std::vector<uint64_t>({ live, live, live, 0, 0, live, 0, live, 0 }));
+
+	pattern_cells(glider, 2, 3, true, cells.data());
+	CHECK(cells[3] == EDIT_KEEP && cells[0] == live);
+
+	pattern_cells(glider, 0, 3, true, cells.data());
+	CHECK(cells[0] == 0 && cells[3] == EDIT_KEEP);
+
+	// Later states count on from the species, wrapping past the board's last
+	std::vector<uint64_t> multi(8);
+	pattern_cells(states, 3, 3, false, multi.data());
+	CHECK(multi[4 + 1] == 1ULL << 8);
+	CHECK(multi[4 + 2] == 1ULL << 0);
+	CHECK(multi[0] == 1ULL << 4);
+
+	Pattern brush = brush_pattern(2);
+	CHECK(brush.width == 5 && brush.height == 5);
+	CHECK(brush.cells[2 * 5 + 2] && !brush.cells[0]);
+	return check_failures;
+}
@@ -0,0 +1,33 @@
+#include "check.h"
+#include "rule.h"
+
+static bool same(Rule a, Rule b) {
+	return a.birth == b.birth && a.survive == b.survive;
+}
+
+int main() {
+	Rule rule;
+	CHECK(parse_rule("B3/S23", &rule) && same(rule, CONWAY));
+	CHECK(parse_rule("b3/s23", &rule) && same(rule, CONWAY));
+	CHECK(parse_rule("S23/B3", &rule) && same(rule, CONWAY));
+	// Legacy notation puts survival first
+	CHECK(parse_rule("23/3", &rule) && same(rule, CONWAY));
+	CHECK(parse_rule("B36/S23", &rule) && rule.birth == (1 << 3 | 1 << 6) && rule.survive == (1 << 2 | 1 << 3));
+	CHECK(parse_rule("B2/S", &rule) && rule.birth == 1 << 2 && rule.survive == 0);
+
+	Rule untouched = CONWAY;
+	CHECK(!parse_rule("B03/S23", &untouched)); // B0 isn't supported
+	CHECK(!parse_rule("B3", &untouched));
+	CHECK(!parse_rule("B3/S23/B4", &untouched));
+	CHECK(!parse_rule("B9/S23", &untouched));
+	CHECK(!parse_rule("B3/S2x", &untouched));
+	CHECK(!parse_rule("", &untouched));
+	CHECK(same(untouched, CONWAY));
+
+	for (const char* text : { "B3/S23", "B36/S23", "B1357/S1357", "B2/S" }) {
+		Rule parsed;
+		Rule again;
+		CHECK(parse_rule(text, &parsed) && parse_rule(rule_string(parsed), &again) && same(parsed, again));
+	}
+	return check_failures;
+}
@@ -0,0 +1,77 @@
+#include <cstring>
+#include <random>
+#include <vector>
+#include "check.h"
+#include "pattern.h"
+#include "simulation.h"
+
+static const char* GLIDER = "x = 3, y = 3\nbo$2bo$3o!";
+
+static size_t population(const Grid* grid) {
+	size_t count = 0;
+	for (int y = 0; y < grid->height; y++) {
+		const uint64_t* row = grid->arr + size_t(y + 1) * (grid->width + 2) + 1;
+		for (int x = 0; x < grid->width; x++) {
+			count += row[x] != 0;
+		}
+	}
+	return count;
+}
+
+/* Random edits, some hanging off the board, on a simulation whose stepper
+ * keeps a frontier and one that steps in place. Each must agree with a
+ * simulation that loads the edited board whole, stepping densely from it. */
+int main() {
+	const int width = 300;
+	const int height = 200;
+	Pattern glider;
+	CHECK(parse_rle(GLIDER, &glider));
+	for (bool in_place : { false, true }) {
+		for (int species : { 1, 3 }) {
+			Grid* edited = grid_init(width, height, species);
+			Grid* loaded = grid_init(width, height, species);
+			clear(edited);
+			clear(loaded);
+			SimulationSettings settings = DEFAULT_SETTINGS;
+			settings.backend = Backend::CPU;
+			settings.seed = 7;
+			settings.in_place = in_place;
+			Simulation simulation(edited, CONWAY, settings);
+			settings.in_place = false;
+			Simulation reference(loaded, CONWAY, settings);
+
+			std::mt19937 rng(species);
+			std::vector<uint64_t> cells;
+			for (int generation = 0; generation < 300 && !check_failures; generation++) {
+				int edits = generation % 7 == 0 ? 1 + rng() % 30 : 0;
+				for (int e = 0; e < edits; e++) {
+					int kind = rng() % 3;
+					int x = int(rng() % (width + 20)) - 10;
+					int y = int(rng() % (height + 20)) - 10;
+					Pattern pattern = kind == 0 ? glider : brush_pattern(rng() % 4);
+					cells.resize(size_t(pattern.width) * pattern.height);
+					// Kind 2 erases, every tenth edit clears a rectangle instead
+					pattern_cells(pattern, kind == 2 ? 0 : 1 + rng() % species, species, kind != 0, cells.data());
+					if (rng() % 10 == 0) {
+						simulation.edit(x, y, 9, 5, nullptr);
+					} else {
+						simulation.edit(x, y, pattern.width, pattern.height, cells.data());
+					}
+				}
+				simulation.applyEdits();
+				CHECK(simulation.hash() == board_hash(simulation.grid()));
+				CHECK(simulation.count() == population(simulation.grid()));
+				if (edits) {
+					reference.load(simulation.grid()->arr, simulation.generation());
+				}
+
+				simulation.step();
+				reference.step();
+				CHECK(simulation.hash() == reference.hash());
+				CHECK(std::memcmp(simulation.grid()->arr, reference.grid()->arr, size(edited) * sizeof(uint64_t)) == 0);
+				CHECK(simulation.count() == reference.count());
+			}
+		}
+	}
+	return check_failures;
+}